@@ -1,91 +1,316 @@
+#define _GNU_SOURCE             
 #include <stdio.h>              
 #include <stdlib.h>             
 #include <string.h>             
 #include <unistd.h>             
 #include <sys/types.h>          
 #include <sys/wait.h>           
+#include <sys/stat.h>           
 #include <fcntl.h>              
 #include <signal.h>             
 #include <dirent.h>             
 #include <ctype.h>              
 #include <errno.h>              
+#include <limits.h>             
+#include <spawn.h>              
+#include <stdint.h>             
+#include <pthread.h>            
+#include <semaphore.h>          
+#include <sys/mman.h>           
+#include <sys/sendfile.h>       
+#include <sys/epoll.h>          
+#include <sys/syscall.h>        
+#include <sys/time.h>           
+#include <sys/resource.h>       
+#include <poll.h>               
+#include <time.h>               
+#include <termios.h>            
+#include <sys/uio.h>            
+#include <sys/inotify.h>        
+#include <sys/ioctl.h>          
+#include <sys/file.h>           
+#include <sys/socket.h>         
+#include <sys/un.h>             
+#include <sys/sysmacros.h>      
 
-#define MAX_CMD_LEN 1024        
-#define MAX_ARGS 5              
-#define MAX_PIPES 5             
-#define MAX_COMMANDS 5          
+// Line Arena
+// Words, argument vectors and AST nodes for one input line are bump-allocated
+// here and all released together by arena_reset() once the line has run.
+#define ARENA_BLOCK (64 * 1024) 
 
-// Process Management Functions
-int validate_argc(int argc) {   // This function checks if the number of arguments is okay
-    return (argc >= 1 && argc <= MAX_ARGS);  // Returns true if args are between 1 and MAX_ARGS
+typedef struct arena_block {    // One chunk of arena memory
+    struct arena_block *next;   // Previously filled block
+    size_t used;                // Bytes handed out so far
+    size_t size;                // Capacity of data
+    _Alignas(16) char data[];   // The memory itself
+} arena_block;
+
+typedef struct arena_mapping {  // mmap()ed memory released with the arena
+    void *addr;                 // Start of the mapping
+    size_t len;                 // Its length
+    struct arena_mapping *next; // Next mapping
+} arena_mapping;
+
+typedef struct {                // Bump allocator for one input line
+    arena_block *head;          // Block currently being filled
+    arena_mapping *maps;        // Mappings to drop on reset
+} arena;
+
+void *arena_alloc(arena *a, size_t n) {  // Hands out n bytes, 16-byte aligned
+    n = (n + 15) & ~(size_t)15; // Round up to keep alignment
+    if (!a->head || a->head->size - a->head->used < n) {  // Current block is full
+        size_t size = n > ARENA_BLOCK ? n : ARENA_BLOCK;  // Oversized requests get their own block
+        arena_block *b = malloc(sizeof(arena_block) + size);  // New block
+        if (!b) {               // Out of memory
+            perror("malloc failed");  // Report the error
+            exit(1);            // Nothing sensible left to do
+        }
+        b->next = a->head;      // Chain the old block behind it
+        b->used = 0;            // Nothing handed out yet
+        b->size = size;         // Remember its capacity
+        a->head = b;            // Fill this one from now on
+    }
+    void *p = a->head->data + a->head->used;  // Next free byte
+    a->head->used += n;         // Bump
+    return p;                   // Caller's memory
+}
+
+void *arena_grow(arena *a, void *old, size_t old_n, size_t n) {  // Enlarges the block at old to n bytes, in place if it was the last allocation
+    size_t old_round = (old_n + 15) & ~(size_t)15;  // What arena_alloc really handed out
+    size_t new_round = (n + 15) & ~(size_t)15;  // What we need now
+    if (old && a->head && (char *)old + old_round == a->head->data + a->head->used &&
+        (char *)old + new_round <= a->head->data + a->head->size) {  // Last allocation with room behind it
+        a->head->used += new_round - old_round;  // Just bump
+        return old;             // Same memory
+    }
+    void *p = arena_alloc(a, n);  // Move it
+    if (old_n) memcpy(p, old, old_n);  // Keep the contents
+    return p;                   // New memory (the old bytes go with the line)
+}
+
+void arena_map(arena *a, void *addr, size_t len) {  // Hands an mmap()ed region to the arena to unmap on reset
+    arena_mapping *m = arena_alloc(a, sizeof(arena_mapping));  // Record lives in the arena itself
+    m->addr = addr;             // Start
+    m->len = len;               // Length
+    m->next = a->maps;          // Push it
+    a->maps = m;                // On the list
+}
+
+void arena_reset(arena *a) {    // Releases everything at once, keeping one block for the next line
+    for (arena_mapping *m = a->maps; m; m = m->next) munmap(m->addr, m->len);  // Drop mappings first (their records are in the blocks)
+    a->maps = NULL;             // None left
+    if (!a->head) return;       // Nothing allocated yet
+    while (a->head->next) {     // Free all but the newest block
+        arena_block *old = a->head->next;  // Block to drop
+        a->head->next = old->next;  // Unlink it
+        free(old);              // Release it
+    }
+    if (a->head->size > ARENA_BLOCK) {  // An oversized block (a big capture) is not worth keeping
+        free(a->head);          // Release it
+        a->head = NULL;         // Next line starts a fresh block
+        return;                 // Done
+    }
+    a->head->used = 0;          // Newest block is empty again
+}
+
+typedef struct {                // Growable pointer array living in an arena
+    void **items;               // NULL-terminated array
+    int count;                  // Used slots
+    int cap;                    // Capacity (not counting the terminator)
+} ptr_list;
+
+void list_push(arena *a, ptr_list *list, void *item) {  // Appends one pointer
+    if (list->count == list->cap) {  // Out of room
+        int cap = list->cap ? list->cap * 2 : 8;  // Double it
+        void **items = arena_alloc(a, (cap + 1) * sizeof(void *));  // Bigger array
+        if (list->count) memcpy(items, list->items, list->count * sizeof(void *));  // Keep what we had
+        list->items = items;    // Switch over
+        list->cap = cap;        // New capacity
+    }
+    list->items[list->count++] = item;  // Store the item
+    list->items[list->count] = NULL;    // Keep it NULL-terminated
 }
 
+// Abstract Syntax Tree
+typedef enum {                  // Kinds of parsed nodes
+    NODE_COMMAND,               // words and redirections
+    NODE_PIPELINE,              // cmd | cmd ... or cmd = cmd ...
+    NODE_FANOUT,                // pipeline |> pipeline |> ... (one producer, every branch gets a copy)
+    NODE_CONDITIONAL,           // fanout && fanout || ...
+    NODE_SEQUENCE               // conditional ; conditional ...
+} node_type;
+
+typedef struct pipe_config {    // How a pipeline's pipes are made (see Pipe Tuning)
+    int size;                   // F_SETPIPE_SZ bytes (0 = kernel default)
+    int packet;                 // O_DIRECT packet-mode pipes
+    int meter;                  // Count bytes at every stage boundary
+} pipe_config;
+
+typedef struct redirect {       // One <, > or >> attached to a command
+    int fd;                     // Descriptor it replaces (stdin or stdout)
+    int flags;                  // open() flags for the file
+    char *path;                 // File to open
+    struct redirect *next;      // Next redirection, in source order
+} redirect;
+
+typedef struct node {           // One piece of a parsed line
+    node_type type;             // What kind of node this is
+    int count;                  // Words (command) or children (everything else)
+    char **argv;                // NODE_COMMAND: NULL-terminated words
+    redirect *redirs;           // NODE_COMMAND: redirections
+    struct node **items;        // Children of pipelines, conditionals and sequences
+    char **operators;           // NODE_CONDITIONAL: "&&" or "||" before items[i + 1]
+    int reverse;                // NODE_PIPELINE: joined with = (data flows right to left)
+    int background;             // Followed by & (run without waiting)
+    int timed;                  // Prefixed with time (report how long it took)
+    pipe_config *tuning;        // NODE_PIPELINE: pipe -s/-p/-m prefix (NULL = session settings)
+    arena *expand;              // NODE_COMMAND: arena of a command with $(...) still to run (NULL = none)
+    int memo;                   // NODE_COMMAND: memo prefix (replay stored output when inputs are unchanged)
+} node;
+
+#define SUBST_OPEN "\001"       // Starts $(...) in a lexed word
+#define SUBST_QUOTED "\002"     // Starts "$(...)" (never split into fields)
+#define SUBST_CLOSE "\003"      // Ends either
+#define SUBST_MARKS "\001\002"  // Either start
+#define GLOB_MARK "\004"         // Precedes an unquoted * ? [ ] { } or , in a lexed word
+
+int execute_node(node *n);      // Runs any node and returns its exit status
+int is_shell_command(node *cmd);  // Whether a command runs inside the shell (see Builtin Commands)
+pid_t spawn_builtin(node *cmd, int in_fd, int out_fd);  // Forks a shell-side command as a pipeline stage
+node *parse_line(arena *a, const char *input, const char **error);  // Parses one line into an AST
+
+// Process Management Functions
 void killterm() {               // Simple function to terminate the current shell
     exit(0);                    // Just exits with status 0 (success)
 }
 
+#define KILL_GRACE_MS 100       
+
+int read_comm(int proc_fd, const char *pid, char *name, size_t size) {  // Reads /proc/<pid>/comm into name, 0 or -1
+    char path[64];              // "<pid>/comm"
+    snprintf(path, sizeof(path), "%s/comm", pid);  // Relative to /proc
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);  // Open it
+    if (fd < 0) return -1;      // Process is gone
+    ssize_t n = read(fd, name, size - 1);  // Read the name
+    close(fd);                  // Close the file
+    if (n <= 0) return -1;      // Nothing there
+    name[n] = '\0';             // Null terminate
+    name[strcspn(name, "\n")] = '\0';  // Drop the newline
+    return 0;                   // Got it
+}
+
+long long now_ns(void) {        // Monotonic clock in nanoseconds
+    struct timespec ts;         // Current time
+    clock_gettime(CLOCK_MONOTONIC, &ts);  // Read the clock
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;  // Convert
+}
+
 void killallterms() {           // This function kills all instances of our shell
     pid_t my_pid = getpid();    // Gets our current process ID
-    char self_name[256] = {0};  // Array to store our process name, initialized to zeros
-    FILE *fp;                   // File pointer for reading process info
-    char line[256];             // Buffer for reading lines from process list
+    char self_name[64] = "w25shell";  // Our process name (comm), defaults to "w25shell"
     int found = 0, killed = 0;  // Counters for processes found and killed
+    int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);  // All lookups are relative to /proc
+    DIR *dir = proc_fd >= 0 ? fdopendir(dup(proc_fd)) : NULL;  // Directory stream over /proc
+    if (!dir) {                 // If /proc is not available
+        perror("Failed to read /proc");  // Report the error
+        if (proc_fd >= 0) close(proc_fd);  // Close what we opened
+        return;                 // Give up
+    }
+    if (read_comm(proc_fd, "self", self_name, sizeof(self_name)) < 0) perror("Failed to get process name");  // Keep the default
 
-    // Get process name
-    FILE *cmd_fp = fopen("/proc/self/cmdline", "r");  // Opens our command line info
-    if (cmd_fp) {               // If we successfully opened the file
-        size_t bytes = fread(self_name, 1, sizeof(self_name) - 1, cmd_fp);  // Read our command name
-        fclose(cmd_fp);         // Close the file
-        self_name[bytes] = '\0'; // Null terminate the string
-        char *basename = strrchr(self_name, '/');  // Find the last slash
-        if (basename) memmove(self_name, basename + 1, strlen(basename));  // Keep just the filename
-        for (int i = 0; i < sizeof(self_name) - 1 && self_name[i]; i++) {  // Clean up any junk
-            if (self_name[i] == '\0') {  // If we hit a null character
-                self_name[i] = '\0';     // Make sure it's properly terminated
-                break;                   // Stop the loop
+    // Find instances and take a pidfd on each, so a recycled PID can never be signalled
+    struct pollfd *fds = NULL;  // pidfds to wait on (fd < 0 once handled)
+    pid_t *pids = NULL;         // Matching PIDs
+    int count = 0, cap = 0;     // Entries used and allocated
+    uid_t uid = getuid();       // Only our own processes, like ps -u
+    struct dirent *de;          // Directory entry
+    while ((de = readdir(dir))) {  // Every /proc entry
+        if (!isdigit((unsigned char)de->d_name[0])) continue;  // Only process directories
+        char name[64];          // Its comm
+        struct stat st;         // Its owner
+        if (read_comm(proc_fd, de->d_name, name, sizeof(name)) < 0 || strcmp(name, self_name) != 0) continue;  // Not our shell
+        if (fstatat(proc_fd, de->d_name, &st, 0) < 0 || st.st_uid != uid) continue;  // Someone else's
+        found++;                // Increment found counter
+        pid_t pid = atoi(de->d_name);  // Its PID
+        if (pid == my_pid) continue;  // Not our current process
+        int pidfd = syscall(SYS_pidfd_open, pid, 0);  // Stable handle on this exact process
+        if (pidfd < 0 && errno != ENOSYS) { found--; continue; }  // Exited in the meantime
+        if (pidfd >= 0 && (read_comm(proc_fd, de->d_name, name, sizeof(name)) < 0 || strcmp(name, self_name) != 0)) {  // PID was reused before we got the handle
+            close(pidfd);       // Not ours after all
+            found--;            // Undo the count
+            continue;           // Skip it
+        }
+        if (count == cap) {     // Grow the arrays
+            cap = cap ? cap * 2 : 64;  // Double
+            struct pollfd *more_fds = realloc(fds, cap * sizeof(struct pollfd));  // pidfds
+            if (more_fds) fds = more_fds;  // Keep the old array if that failed
+            pid_t *more_pids = more_fds ? realloc(pids, cap * sizeof(pid_t)) : NULL;  // PIDs
+            if (more_pids) pids = more_pids;  // Same
+            if (!more_fds || !more_pids) {  // Out of memory
+                perror("realloc failed");  // Report the error
+                if (pidfd >= 0) close(pidfd);  // This one will not be signalled
+                break;          // Still terminate the instances found so far
             }
         }
-    } else {                    // If we couldn't open the file
-        perror("Failed to get process name");  // Print an error
-        strcpy(self_name, "w25shell");  // Default to "w25shell"
+        fds[count] = (struct pollfd){.fd = pidfd, .events = POLLIN};  // Readable once the process exits
+        pids[count++] = pid;    // Remember the PID
     }
+    closedir(dir);              // Close the directory stream
 
-    // Find and kill processes
-    char command[256];          // Buffer for our ps command
-    snprintf(command, sizeof(command), "ps -u %d -o pid,comm", getuid());  // Build command to list processes
-    fp = popen(command, "r");   // Run the command and open a pipe to read output
-    if (!fp) {                  // If the pipe failed
-        perror("popen failed"); // Print an error
-        return;                 // Give up
+    // SIGTERM every instance at once
+    int waiting = 0;            // Instances whose exit we can watch
+    for (int i = 0; i < count; i++) {  // Each instance
+        printf("Attempting to kill %s PID %d\n", self_name, pids[i]);  // Announce attempt
+        int rc = fds[i].fd >= 0 ? syscall(SYS_pidfd_send_signal, fds[i].fd, SIGTERM, NULL, 0) : kill(pids[i], SIGTERM);  // Try to terminate nicely
+        if (rc == -1) {         // Could not signal it
+            fprintf(stderr, "Failed to kill PID %d: %s\n", pids[i], strerror(errno));  // Report failure
+            if (fds[i].fd >= 0) close(fds[i].fd);  // Drop its handle
+            fds[i].fd = -1;     // Nothing more to do
+            pids[i] = 0;        // Handled
+        } else if (fds[i].fd >= 0) {  // Watch it
+            waiting++;          // One more to wait for
+        }
     }
 
-    while (fgets(line, sizeof(line), fp) != NULL) {  // Read each line of process info
-        int proc_id;            // To store process ID
-        char proc_name[256];    // To store process name
-        if (sscanf(line, "%d %s", &proc_id, proc_name) == 2) {  // Parse PID and name
-            if (strcmp(proc_name, self_name) == 0) {  // If this is our shell
-                found++;        // Increment found counter
-                if (proc_id != my_pid) {  // If it's not our current process
-                    printf("Attempting to kill %s PID %d\n", self_name, proc_id);  // Announce attempt
-                    if (kill(proc_id, SIGTERM) == -1) {  // Try to terminate nicely
-                        fprintf(stderr, "Failed to kill PID %d: %s\n", proc_id, strerror(errno));  // Report failure
-                    } else {        // If SIGTERM worked
-                        usleep(100000);  // Wait a bit (100ms)
-                        if (kill(proc_id, 0) == -1 && errno == ESRCH) {  // Check if process is gone
-                            printf("Successfully killed PID %d with SIGTERM\n", proc_id);  // Success!
-                            killed++;  // Increment killed counter
-                        } else if (kill(proc_id, SIGKILL) == -1) {  // Try forceful kill
-                            fprintf(stderr, "Failed to kill PID %d with SIGKILL: %s\n", proc_id, strerror(errno));  // Report failure
-                        } else {    // If SIGKILL worked
-                            printf("Successfully killed PID %d with SIGKILL\n", proc_id);  // Success!
-                            killed++;  // Increment killed counter
-                        }
-                    }
-                }
-            }
+    // Wait for all of them together, with one deadline
+    long long deadline = now_ns() / 1000000 + KILL_GRACE_MS;  // Single grace period for every instance
+    while (1) {                 // Until all exited or time is up
+        long long left = deadline - now_ns() / 1000000;  // Time remaining
+        if (left <= 0 || count == 0) break;  // Done waiting
+        int n = poll(fds, count, left);  // Sleep until an exit or the deadline (no pidfds: just the grace period)
+        if (n < 0 && errno == EINTR) continue;  // Interrupted, try again
+        if (n <= 0) break;      // Deadline reached (or an error)
+        for (int i = 0; i < count; i++) {  // Each instance that exited
+            if (fds[i].fd < 0 || !fds[i].revents) continue;  // Still running
+            printf("Successfully killed PID %d with SIGTERM\n", pids[i]);  // Success!
+            killed++;           // Increment killed counter
+            close(fds[i].fd);   // Drop its handle
+            fds[i].fd = -1;     // poll ignores it from now on
+            pids[i] = 0;        // Handled
+            waiting--;          // One less to wait for
+        }
+        if (!waiting) break;    // Everyone with a pidfd is gone (any without one were checked below)
+    }
+
+    // SIGKILL only the survivors
+    for (int i = 0; i < count; i++) {  // Each instance
+        if (!pids[i]) continue; // Already handled
+        if (fds[i].fd < 0 && kill(pids[i], 0) == -1 && errno == ESRCH) {  // No pidfd, but it is gone
+            printf("Successfully killed PID %d with SIGTERM\n", pids[i]);  // Success!
+            killed++;           // Increment killed counter
+            continue;           // Next one
         }
+        int rc = fds[i].fd >= 0 ? syscall(SYS_pidfd_send_signal, fds[i].fd, SIGKILL, NULL, 0) : kill(pids[i], SIGKILL);  // Try forceful kill
+        if (rc == -1) fprintf(stderr, "Failed to kill PID %d with SIGKILL: %s\n", pids[i], strerror(errno));  // Report failure
+        else {                  // If SIGKILL worked
+            printf("Successfully killed PID %d with SIGKILL\n", pids[i]);  // Success!
+            killed++;           // Increment killed counter
+        }
+        if (fds[i].fd >= 0) close(fds[i].fd);  // Drop its handle
     }
-    pclose(fp);                 // Close the pipe
+    free(fds);                  // Release the arrays
+    free(pids);                 // Release the arrays
+    close(proc_fd);             // Close /proc
 
     // Print results and kill self
     if (found == 0) printf("No %s instances found\n", self_name);  // No instances at all
@@ -95,431 +320,3844 @@ void killallterms() {           // This function kills all instances of our shel
     if (found > 0) {            // If we found any instances
         printf("Killing self: %s PID %d\n", self_name, my_pid);  // Announce self-destruction
         fflush(stdout);         // Make sure output is shown
-        usleep(100000);         // Wait a bit (100ms)
         kill(my_pid, SIGKILL);  // Kill ourselves forcefully
     }
 }
 
 // I/O Redirection
-void handle_redirection(char **args) {  // Handles input/output redirection
-    for (int i = 0; args[i]; i++) {     // Loop through all arguments
-        if (strcmp(args[i], "<") == 0) {  // If we see input redirection
-            if (!args[i + 1]) {         // Check if there's a filename after <
-                fprintf(stderr, "Error: < requires a file argument\n");  // Complain if not
-                return;                 // Stop processing
-            }
-            int fd = open(args[i + 1], O_RDONLY);  // Open the file for reading
-            if (fd < 0) {           // If opening failed
-                perror("Error opening file for input");  // Report the error
-                return;             // Stop processing
-            }
-            dup2(fd, STDIN_FILENO);  // Redirect stdin to this file
-            close(fd);              // Close the file descriptor
-            args[i] = NULL;         // Remove the < from args
-        } else if (strcmp(args[i], ">") == 0) {  // If we see output redirection
-            if (!args[i + 1]) {     // Check if there's a filename after >
-                fprintf(stderr, "Error: > requires a file argument\n");  // Complain if not
-                return;             // Stop processing
-            }
-            int fd = open(args[i + 1], O_WRONLY | O_CREAT | O_TRUNC, 0644);  // Open file for writing
-            if (fd < 0) {           // If opening failed
-                perror("Error opening file for output");  // Report the error
-                return;             // Stop processing
-            }
-            dup2(fd, STDOUT_FILENO);  // Redirect stdout to this file
-            close(fd);              // Close the file descriptor
-            args[i] = NULL;         // Remove the > from args
-        } else if (strcmp(args[i], ">>") == 0) {  // If we see append redirection
-            if (!args[i + 1]) {     // Check if there's a filename after >>
-                fprintf(stderr, "Error: >> requires a file argument\n");  // Complain if not
-                return;             // Stop processing
+int handle_redirection(redirect *redirs) {  // Applies a command's redirections to this process, 0 or -1
+    for (redirect *r = redirs; r; r = r->next) {  // In source order
+        int fd = open(r->path, r->flags, 0644);  // Open the file
+        if (fd < 0) {           // If opening failed
+            perror(r->fd == STDIN_FILENO ? "Error opening file for input" :
+                   (r->flags & O_APPEND) ? "Error opening file for appending" : "Error opening file for output");  // Report the error
+            return -1;          // Stop processing
+        }
+        dup2(fd, r->fd);        // Point stdin/stdout at the file
+        close(fd);              // Close the file descriptor
+    }
+    return 0;                   // All redirections applied
+}
+
+// Executable Lookup Cache
+#define HASH_BUCKETS 64         
+
+typedef struct hash_entry {     // One remembered command name -> absolute path
+    char *name;                 // Command name as typed (no slash)
+    char *path;                 // Absolute path it resolved to
+    int hits;                   // How many launches used this entry
+    struct hash_entry *next;    // Next entry in the same bucket
+} hash_entry;
+
+hash_entry *hash_table[HASH_BUCKETS];  // Buckets of the command cache
+char *hash_path_env = NULL;     // Copy of $PATH the cache was filled against
+
+unsigned hash_name(const char *name) {  // FNV-1a hash of a command name
+    unsigned h = 2166136261u;   // FNV offset basis
+    while (*name) h = (h ^ (unsigned char)*name++) * 16777619u;  // Mix in each byte
+    return h % HASH_BUCKETS;    // Pick a bucket
+}
+
+void hash_clear(void) {         // Drops every cached entry
+    for (int i = 0; i < HASH_BUCKETS; i++) {  // For each bucket
+        while (hash_table[i]) { // Free the whole chain
+            hash_entry *e = hash_table[i];  // Entry to drop
+            hash_table[i] = e->next;  // Unlink it
+            free(e->name);      // Free its name
+            free(e->path);      // Free its path
+            free(e);            // Free the entry
+        }
+    }
+}
+
+void hash_forget(const char *name) {  // Drops one entry (its path went away)
+    hash_entry **link = &hash_table[hash_name(name)];  // Start of the chain
+    while (*link) {             // Walk the chain
+        if (strcmp((*link)->name, name) == 0) {  // Found it
+            hash_entry *e = *link;  // Entry to drop
+            *link = e->next;    // Unlink it
+            free(e->name);      // Free its name
+            free(e->path);      // Free its path
+            free(e);            // Free the entry
+            return;             // Names are unique
+        }
+        link = &(*link)->next;  // Next entry
+    }
+}
+
+const char *hash_lookup(const char *name) {  // Resolves a command name to an executable path, NULL if not found
+    if (strchr(name, '/')) return name;  // Explicit paths are used as-is
+    const char *path_env = getenv("PATH");  // Current search path
+    if (!path_env) path_env = "/usr/local/bin:/usr/bin:/bin";  // Same default execvp uses
+    if (!hash_path_env || strcmp(hash_path_env, path_env) != 0) {  // PATH changed since we filled the cache
+        hash_clear();           // Old answers may be wrong now
+        free(hash_path_env);    // Forget the old PATH
+        hash_path_env = strdup(path_env);  // Remember the new one
+    }
+
+    unsigned bucket = hash_name(name);  // Where this name lives
+    for (hash_entry *e = hash_table[bucket]; e; e = e->next) {  // Look through the chain
+        if (strcmp(e->name, name) == 0) {  // Cache hit
+            e->hits++;          // Count the use
+            return e->path;     // No PATH walk needed
+        }
+    }
+
+    const char *dir = path_env; // Cache miss: walk $PATH once
+    while (1) {                 // For each directory
+        size_t dir_len = strcspn(dir, ":");  // Length of this entry
+        char candidate[4096];   // dir/name
+        if (dir_len == 0) snprintf(candidate, sizeof(candidate), "%s", name);  // Empty entry means current directory
+        else snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)dir_len, dir, name);  // Join dir and name
+        struct stat st;         // File info
+        if (access(candidate, X_OK) == 0 && stat(candidate, &st) == 0 && S_ISREG(st.st_mode)) {  // Runnable file
+            hash_entry *e = malloc(sizeof(hash_entry));  // New cache entry
+            e->name = strdup(name);  // Remember the name
+            e->path = strdup(candidate);  // And where it lives
+            e->hits = 1;        // This lookup is its first use
+            e->next = hash_table[bucket];  // Push onto the chain
+            hash_table[bucket] = e;  // Insert it
+            return e->path;     // Resolved
+        }
+        if (!dir[dir_len]) break;  // Last entry
+        dir += dir_len + 1;     // Move past the colon
+    }
+    return NULL;                // Not found anywhere
+}
+
+void hash_builtin(char **args) {  // hash: list the cache, hash -r: clear it
+    if (args[1] && strcmp(args[1], "-r") == 0) {  // Clear request
+        hash_clear();           // Drop everything
+        return;                 // Done
+    }
+    int shown = 0;              // Entries printed
+    for (int i = 0; i < HASH_BUCKETS; i++) {  // For each bucket
+        for (hash_entry *e = hash_table[i]; e; e = e->next) {  // For each entry
+            if (!shown++) printf("hits\tcommand\n");  // Header before the first row
+            printf("%4d\t%s\n", e->hits, e->path);  // One row per command
+        }
+    }
+    if (!shown) printf("hash: hash table empty\n");  // Nothing cached yet
+}
+
+// Spawn Engine
+extern char **environ;          // Environment handed to every spawned command
+int spawn_use_fork = 0;         // 1 = always launch with fork()+exec (set by W25SHELL_SPAWN=fork)
+
+int add_redirection_actions(redirect *redirs, posix_spawn_file_actions_t *actions) {  // Turns <, >, >> into spawn file actions
+    for (redirect *r = redirs; r; r = r->next) {  // In source order
+        if (posix_spawn_file_actions_addopen(actions, r->fd, r->path, r->flags, 0644) != 0) return -1;  // Child opens the file onto r->fd
+    }
+    return 0;                   // Actions ready
+}
+
+pid_t spawn_command(node *cmd, int in_fd, int out_fd) {  // Launches a command wired to in_fd/out_fd (-1 = inherit), returns pid or -1
+    char **argv = cmd->argv;    // Words to exec
+    fflush(stdout);             // Shell output printed so far must come before the child's
+    if (!spawn_use_fork) {      // Preferred path: posix_spawn (clone with CLONE_VM|CLONE_VFORK, no page-table copy)
+        posix_spawn_file_actions_t actions;  // Fd setup the child performs before exec
+        if (posix_spawn_file_actions_init(&actions) == 0) {  // If we could set up the action list
+            int err = 0;        // posix_spawn error code
+            pid_t pid;          // Child process ID
+            if (in_fd >= 0) err = posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);  // Wire stdin
+            if (!err && out_fd >= 0) err = posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);  // Wire stdout
+            if (!err && add_redirection_actions(cmd->redirs, &actions) < 0) err = ENOMEM;  // Could not record the redirections
+            for (int attempt = 0; !err && attempt < 2; attempt++) {  // Second try only if a cached path went stale
+                const char *path = hash_lookup(argv[0]);  // Resolve through the command cache
+                if (!path) { err = ENOENT; break; }  // Not on PATH at all
+                err = posix_spawn(&pid, path, &actions, NULL, argv, environ);  // Launch the command directly
+                if (err != ENOENT || path == argv[0] || access(path, X_OK) == 0) break;  // Not a stale cache entry
+                hash_forget(argv[0]);  // Binary moved or was removed: look it up again
+                err = 0;        // Retry
             }
-            int fd = open(args[i + 1], O_WRONLY | O_CREAT | O_APPEND, 0644);  // Open file for appending
-            if (fd < 0) {           // If opening failed
-                perror("Error opening file for appending");  // Report the error
-                return;             // Stop processing
+            posix_spawn_file_actions_destroy(&actions);  // Release the action list
+            if (err == 0) return pid;  // Launched
+            if (err != ENOSYS && err != ENOMEM && err != EAGAIN) {  // A real exec/open failure, not a spawn limitation
+                fprintf(stderr, "exec failed: %s\n", strerror(err));  // Report like the old child did
+                return -1;      // Nothing launched
             }
-            dup2(fd, STDOUT_FILENO);  // Redirect stdout to append to this file
-            close(fd);              // Close the file descriptor
-            args[i] = NULL;         // Remove the >> from args
         }
     }
+
+    const char *path = hash_lookup(argv[0]);  // Resolve before forking so the cache lives in the parent
+    if (path && path != argv[0] && access(path, X_OK) != 0) {  // Cached binary is gone
+        hash_forget(argv[0]);   // Drop the stale entry
+        path = hash_lookup(argv[0]);  // And search again
+    }
+    int exec_pipe[2];           // Close-on-exec pipe: EOF once the child has exec'd (or died)
+    if (pipe2(exec_pipe, O_CLOEXEC) < 0) exec_pipe[0] = exec_pipe[1] = -1;  // Out of descriptors: just do not wait
+    pid_t pid = fork();         // Fallback: create a new process the classic way
+    if (pid == 0) {             // In the child process
+        if (exec_pipe[0] >= 0) close(exec_pipe[0]);  // Only the parent reads
+        if (in_fd >= 0) dup2(in_fd, STDIN_FILENO);  // Connect input
+        if (out_fd >= 0) dup2(out_fd, STDOUT_FILENO);  // Connect output
+        if (handle_redirection(cmd->redirs) < 0) _exit(1);  // Set up any additional redirection
+        if (path) execve(path, argv, environ);  // Execute the resolved binary
+        else errno = ENOENT;    // Not found on PATH
+        int err = errno;        // Why exec failed
+        perror("exec failed");  // If we get here, exec failed
+        _exit(err == ENOENT ? 127 : 126);  // Same statuses as the posix_spawn path: not found, not executable
+    } else if (pid < 0) {       // If fork failed
+        perror("fork failed");  // Report the error
+    }
+    if (exec_pipe[0] >= 0) {    // Return only once the program is running, like posix_spawn (so spawn latency means the same on both paths)
+        close(exec_pipe[1]);    // Child holds the only write end now
+        char c;                 // Never written
+        if (pid > 0) while (read(exec_pipe[0], &c, 1) < 0 && errno == EINTR);  // EOF at exec
+        close(exec_pipe[0]);    // Done
+    }
+    return pid;                 // Child pid or -1
 }
 
-// Command Execution Functions
-void execute_command(char **args) {  // Runs a single command
-    if (!args[0]) return;           // If no command, just return
-    int argc = 0;                   // Counter for arguments
-    while (args[argc]) argc++;      // Count how many arguments we have
-    if (!validate_argc(argc)) {     // Check if argument count is valid
-        fprintf(stderr, "Argument count must be between 1 and %d\n", MAX_ARGS);  // Complain if not
-        return;                     // Stop processing
+// Pipe Tuning
+// Pipes between stages default to the kernel's 64 KiB. `set -o pipesize` (or a
+// `pipe -s` prefix on one pipeline) grows them with F_SETPIPE_SZ so big streams
+// move in fewer, larger chunks. `pipepacket` makes them O_DIRECT packet pipes,
+// and `pipemeter` puts a splice() pump between stages that counts the bytes
+// crossing each boundary without copying them.
+pipe_config pipe_session = {0, 0, 0};  // set -o pipesize / pipepacket / pipemeter
+long capture_memfd_threshold = 0;  // set -o capturememfd: $(...) output past this goes to a memfd (0 = never)
+long memo_size_cap = 256L << 20;  // set -o memosize: memo store size before eviction
+int pipe_resize_warned = 0;     // F_SETPIPE_SZ failure reported once
+
+long pipe_max_size(void) {      // Largest size an unprivileged pipe may be given
+    long max = 1048576;         // Kernel default for pipe-max-size
+    FILE *fp = fopen("/proc/sys/fs/pipe-max-size", "r");  // Current limit
+    if (fp) {                   // If /proc is there
+        if (fscanf(fp, "%ld", &max) != 1) max = 1048576;  // Read it
+        fclose(fp);             // Close the file
     }
+    return max;                 // Limit in bytes
+}
+
+long size_parse(const char *text) {  // "65536", "256k", "1m" or "1g" in bytes, -1 if invalid
+    char *end;                  // End of the number
+    long size = strtol(text, &end, 10);  // The number
+    if (end == text || size <= 0) return -1;  // Not a size
+    if (*end == 'k' || *end == 'K') size <<= 10, end++;  // Kilobytes
+    else if (*end == 'm' || *end == 'M') size <<= 20, end++;  // Megabytes
+    else if (*end == 'g' || *end == 'G') size <<= 30, end++;  // Gigabytes
+    if (*end) return -1;        // Trailing junk
+    return size;                // Bytes
+}
+
+long pipe_size_parse(const char *text) {  // A size or "max" in bytes (clamped to pipe-max-size), -1 if invalid
+    long max = pipe_max_size(); // Upper bound
+    if (strcmp(text, "max") == 0) return max;  // Largest allowed
+    long size = size_parse(text);  // Plain size
+    return size > max ? max : size;  // The kernel rounds up to whole pages
+}
 
-    pid_t pid = fork();             // Create a new process
-    if (pid == 0) {                 // In the child process
-        handle_redirection(args);   // Set up any I/O redirection
-        execvp(args[0], args);      // Execute the command
-        perror("exec failed");      // If we get here, exec failed
-        exit(1);                    // Exit child with error
-    } else if (pid > 0) {           // In the parent process
-        wait(NULL);                 // Wait for child to finish
-    } else {                        // If fork failed
-        perror("fork failed");      // Report the error
+pipe_config pipe_effective(const pipe_config *tuning) {  // Session settings with a pipeline's own pipe prefix on top
+    pipe_config cfg = pipe_session;  // Start from the session
+    if (tuning) {               // pipe -s/-p/-m
+        if (tuning->size) cfg.size = tuning->size;  // Its size wins
+        cfg.packet |= tuning->packet;  // Options only switch things on
+        cfg.meter |= tuning->meter;  // Same for the meter
     }
+    return cfg;                 // What this pipeline uses
 }
 
-void execute_piped_commands(char ***commands, int num_pipes) {  // Handles piped commands
-    if (num_pipes >= MAX_PIPES) {  // Check if we have too many pipes
-        fprintf(stderr, "Maximum %d pipes allowed\n", MAX_PIPES - 1);  // Complain if so
-        return;                    // Stop processing
+int pipe_open(int pipefd[2], const pipe_config *cfg) {  // Creates one pipe between stages, 0 or -1
+    if (pipe2(pipefd, O_CLOEXEC | (cfg->packet ? O_DIRECT : 0)) < 0) return -1;  // Closed automatically on exec
+    if (cfg->size && fcntl(pipefd[1], F_SETPIPE_SZ, cfg->size) < 0 && !pipe_resize_warned) {  // Resize it
+        fprintf(stderr, "w25shell: cannot resize pipe to %d bytes: %s\n", cfg->size, strerror(errno));  // Over the per-user pipe budget
+        pipe_resize_warned = 1; // Say it once; the pipe still works at its old size
     }
+    return 0;                   // Pipe ready
+}
 
-    int pipefd[2 * num_pipes];     // Array for pipe file descriptors
-    for (int i = 0; i < num_pipes; i++) {  // Create all needed pipes
-        if (pipe(pipefd + i * 2) < 0) {  // Try to create a pipe
-            perror("pipe failed"); // Report if it fails
-            return;                // Stop processing
+typedef struct pipe_meter {     // A splice pump between two stages
+    int in_fd;                  // Read end of the upstream stage's pipe
+    int out_fd;                 // Write end of the downstream stage's pipe
+    const char *from, *to;      // Stage names for the report
+    long long bytes;            // Bytes that crossed
+    long long start_ns, end_ns; // Pump lifetime
+    pthread_t thread;           // Pump thread
+    struct pipe_meter *next;    // Next boundary
+} pipe_meter;
+
+pipe_meter *meter_list = NULL;  // Pumps of the running foreground pipeline
+
+void *pipe_meter_thread(void *arg) {  // Moves pages from one pipe to the next, counting bytes
+    pipe_meter *m = arg;        // This boundary
+    sigset_t block;             // SIGPIPE would kill the whole shell
+    sigemptyset(&block);        // Start empty
+    sigaddset(&block, SIGPIPE); // Get EPIPE instead
+    pthread_sigmask(SIG_BLOCK, &block, NULL);  // For this thread only
+    m->start_ns = now_ns();     // Start the clock
+    while (1) {                 // Until EOF or the reader goes away
+        ssize_t n = splice(m->in_fd, NULL, m->out_fd, NULL, 1 << 20, SPLICE_F_MOVE);  // Pipe to pipe, no copy to user space
+        if (n < 0 && errno == EINTR) continue;  // Interrupted
+        if (n <= 0) break;      // EOF, or downstream exited
+        m->bytes += n;          // Count them
+    }
+    m->end_ns = now_ns();       // Stop the clock
+    close(m->in_fd);            // Upstream now sees EPIPE if still writing
+    close(m->out_fd);           // Downstream sees EOF
+    return NULL;                // Done
+}
+
+void pipe_meters_finish(void) { // Waits for every pump and reports its traffic on stderr
+    while (meter_list) {        // Each boundary in launch order
+        pipe_meter *m = meter_list;  // This one
+        pthread_join(m->thread, NULL);  // Already done once its stages have exited
+        double secs = (m->end_ns - m->start_ns) / 1e9;  // Lifetime
+        fprintf(stderr, "meter: %s -> %s: %lld bytes in %.3f s (%.1f MB/s)\n",
+                m->from, m->to, m->bytes, secs, secs > 0 ? m->bytes / 1048576.0 / secs : 0.0);  // Report
+        meter_list = m->next;   // Next boundary
+        free(m);                // Release it
+    }
+}
+
+typedef struct fanout_link {    // One hop of a |> chain: copies its input on to the rest of the chain and feeds one branch
+    int in_fd;                  // Read end of the stream still owed to this branch and every later one
+    int out_fd;                 // Write end of this branch's input pipe
+    int next_fd;                // Write end of the pipe read by the next hop (or the last branch)
+    pthread_t thread;           // Pump thread
+    struct fanout_link *next;   // Next hop
+} fanout_link;
+
+fanout_link *fanout_list = NULL;  // Hops of the running foreground fan-out
+char fanout_scratch[65536];     // Bytes owed to a branch that exited are read here and dropped (shared: contents never matter)
+
+void *fanout_link_thread(void *arg) {  // tee() the stream to the next hop, then splice() the same bytes to this branch
+    fanout_link *l = arg;       // This hop
+    sigset_t block;             // SIGPIPE would kill the whole shell
+    sigemptyset(&block);        // Start empty
+    sigaddset(&block, SIGPIPE); // Get EPIPE instead
+    pthread_sigmask(SIG_BLOCK, &block, NULL);  // For this thread only
+    while (l->out_fd >= 0 || l->next_fd >= 0) {  // Someone still reads
+        ssize_t n;              // Bytes copied to the next hop
+        if (l->next_fd < 0) {   // Only this branch is left: plain splice
+            n = splice(l->in_fd, NULL, l->out_fd, NULL, 1 << 20, SPLICE_F_MOVE);  // Move it on
+            if (n < 0 && errno == EINTR) continue;  // Interrupted
+            if (n <= 0) break;  // EOF, or the branch exited too
+            continue;           // Next chunk
+        }
+        n = tee(l->in_fd, l->next_fd, 1 << 20, 0);  // Duplicate page references, no copy; blocks while the next hop is full
+        if (n < 0 && errno == EINTR) continue;  // Interrupted
+        if (n < 0 && errno == EPIPE) { close(l->next_fd); l->next_fd = -1; continue; }  // Later branches all exited
+        if (n <= 0) break;      // EOF
+        while (n > 0) {         // Now consume exactly those bytes, so the next tee() starts after them
+            ssize_t m = l->out_fd >= 0 ? splice(l->in_fd, NULL, l->out_fd, NULL, n, SPLICE_F_MOVE)  // Blocks while this branch is full: backpressure
+                                       : read(l->in_fd, fanout_scratch, n < (ssize_t)sizeof(fanout_scratch) ? n : (ssize_t)sizeof(fanout_scratch));  // Branch gone: discard
+            if (m < 0 && errno == EINTR) continue;  // Interrupted
+            if (m < 0 && errno == EPIPE) { close(l->out_fd); l->out_fd = -1; continue; }  // This branch exited: keep feeding the others
+            if (m <= 0) break;  // Should not happen: the bytes are already in the pipe
+            n -= m;             // Consumed this much
         }
     }
+    if (l->out_fd >= 0) close(l->out_fd);  // This branch sees EOF
+    if (l->next_fd >= 0) close(l->next_fd);  // So does the rest of the chain
+    close(l->in_fd);            // With nobody left, upstream gets EPIPE
+    return NULL;                // Done
+}
+
+void fanout_finish(void) {      // Waits for every hop of a finished fan-out
+    while (fanout_list) {       // Each hop
+        fanout_link *l = fanout_list;  // This one
+        pthread_join(l->thread, NULL);  // Already done once its stages have exited
+        fanout_list = l->next;  // Next hop
+        free(l);                // Release it
+    }
+}
 
-    pid_t pid;                     // Process ID variable
-    for (int i = 0; i <= num_pipes; i++) {  // For each command in the pipeline
-        int argc = 0;              // Counter for arguments
-        while (commands[i][argc]) argc++;  // Count arguments for this command
-        if (!validate_argc(argc)) {  // Check if argument count is valid
-            fprintf(stderr, "Command %d: Argument count must be between 1 and %d\n", i + 1, MAX_ARGS);  // Complain if not
-            return;                // Stop processing
+void pipe_pumps_start(void) {   // Starts meter and fan-out pumps once every stage has been launched (no forks while they run)
+    for (pipe_meter *m = meter_list; m; m = m->next) {  // Meters
+        if (!m->thread && pthread_create(&m->thread, NULL, pipe_meter_thread, m) != 0) {  // No thread: the stages would block forever
+            perror("pthread_create failed");  // Report the error
+            exit(1);            // Cannot recover the pipeline
+        }
+    }
+    for (fanout_link *l = fanout_list; l; l = l->next) {  // Fan-out hops
+        if (!l->thread && pthread_create(&l->thread, NULL, fanout_link_thread, l) != 0) {  // Same
+            perror("pthread_create failed");  // Report the error
+            exit(1);            // Cannot recover the pipeline
         }
+    }
+}
+
+void pipe_meters_close_in_child(void) {  // A forked child must not hold a pump's pipe ends (downstream would never see EOF)
+    for (pipe_meter *m = meter_list; m; m = m->next) close(m->in_fd), close(m->out_fd);  // Drop them
+    meter_list = NULL;          // Not ours (memory is the child's copy)
+    for (fanout_link *l = fanout_list; l; l = l->next) close(l->in_fd), close(l->out_fd), close(l->next_fd);  // Same for fan-out hops
+    fanout_list = NULL;         // Not ours either
+}
+
+// Job Control
+// Every launch becomes a job that owns its stages' PIDs. Foreground jobs are
+// waited on directly when nothing else is running; otherwise one epoll loop
+// watches a pidfd per stage, so background jobs are reaped the moment they exit
+// (even while the shell sits at the prompt) and nobody reaps another job's child.
+typedef struct job_stage {      // One process of a job
+    pid_t pid;                  // Child process (-1 if it never started)
+    int pidfd;                  // pidfd registered with the event loop (-1 until needed)
+    int status;                 // Exit code once reaped
+    int done;                   // Reaped (or never started)
+    struct job *job;            // Owning job
+    char *label;                // Command text for stats records (only kept when stats are on)
+    long long start_ns;         // When its launch began
+    long long spawn_ns;         // How long the launcher took to get it running
+    int spawn_exec;             // spawn_ns runs until exec (programs); 0 = until fork returned (builtins, subshells)
+    long long end_ns;           // When it was reaped
+    struct rusage usage;        // CPU, memory and context switches, from wait4
+} job_stage;
+
+typedef struct job {            // A command, pipeline or subshell the shell launched
+    int id;                     // Number shown by jobs/fg (0 = foreground)
+    char *text;                 // Command line shown by jobs (background only)
+    int count;                  // Number of stages
+    int remaining;              // Stages still running
+    int sink;                   // Stage whose status is the job's status
+    int reverse;                // Stages are in = order (data flows right to left)
+    job_stage *stages;          // The stages
+    struct job *next;           // Next job in launch order
+} job;
+
+job *job_list = NULL;           // All unreaped jobs, oldest first
+int next_job_id = 1;            // Next background job number
+int pipefail_enabled = 0;       // set -o pipefail
+int interactive = 0;            // Reading commands from a terminal
+int event_fd = -1;              // epoll instance of the event loop
+int pidfd_supported = 1;        // Cleared if the kernel has no pidfd_open
+int stats_fd = -1;              // W25SHELL_STATS: where one JSON record per finished command goes
+
+int status_code(int status) {   // Turns a wait() status into a shell exit code
+    if (WIFEXITED(status)) return WEXITSTATUS(status);  // Normal exit
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);  // Killed by a signal
+    return 1;                   // Anything else counts as failure
+}
+
+job *job_new(int count, int reverse) {  // Creates a job with count not-yet-started stages
+    job *j = calloc(1, sizeof(job));  // Zeroed job
+    j->stages = calloc(count, sizeof(job_stage));  // Its stages
+    j->count = count;           // How many
+    j->reverse = reverse;       // Data-flow direction
+    j->sink = reverse ? 0 : count - 1;  // Stage that produces the final output
+    for (int i = 0; i < count; i++) {  // Each stage
+        j->stages[i] = (job_stage){.pid = -1, .pidfd = -1, .status = 127, .done = 1, .job = j};  // Not started
+    }
+    job **tail = &job_list;     // Append so jobs stay in launch order
+    while (*tail) tail = &(*tail)->next;  // Find the end
+    *tail = j;                  // Link it in
+    return j;                   // New job
+}
+
+void job_add_pid(job *j, int i, pid_t pid, long long started) {  // Records that stage i, launched at `started`, runs as pid
+    if (pid <= 0) return;       // Stage never started: keeps status 127
+    j->stages[i].start_ns = started;  // Launch began
+    j->stages[i].spawn_ns = now_ns() - started;  // Launcher returns once the child is running
+    j->stages[i].pid = pid;     // Remember its PID
+    j->stages[i].done = 0;      // Now running
+    j->remaining++;             // One more to wait for
+}
+
+void job_reap(job_stage *s, int status) {  // Records a stage's exit
+    s->status = status_code(status);  // Its exit code
+    s->end_ns = now_ns();       // Stop its clock
+    s->done = 1;                // Finished
+    if (s->pidfd >= 0) close(s->pidfd), s->pidfd = -1;  // Closing also removes it from epoll
+    s->job->remaining--;        // One less to wait for
+}
 
-        pid = fork();              // Create a new process
-        if (pid == 0) {            // In the child process
-            if (i > 0) dup2(pipefd[(i - 1) * 2], STDIN_FILENO);  // Connect input from previous pipe
-            if (i < num_pipes) dup2(pipefd[i * 2 + 1], STDOUT_FILENO);  // Connect output to next pipe
-            for (int j = 0; j < 2 * num_pipes; j++) close(pipefd[j]);  // Close all pipe ends
-            handle_redirection(commands[i]);  // Set up any additional redirection
-            execvp(commands[i][0], commands[i]);  // Execute the command
-            perror("execvp failed");  // If we get here, exec failed
-            exit(1);                  // Exit child with error
-        } else if (pid < 0) {         // If fork failed
-            perror("fork failed");    // Report the error
-            return;                   // Stop processing
+int job_collect(job_stage *s, int flags) {  // Reaps a stage with wait4 (keeping its rusage) if it has exited, 1 if reaped
+    int status;                 // Child's wait status
+    if (s->done || wait4(s->pid, &status, flags, &s->usage) <= 0) return 0;  // Still running
+    job_reap(s, status);        // Record it
+    return 1;                   // Reaped
+}
+
+int job_status(job *j) {        // Exit status of a finished job
+    int status = j->stages[j->sink].status;  // Normally the last stage decides
+    if (pipefail_enabled) {     // Otherwise the last stage (in data-flow order) that failed
+        for (int step = 0; step < j->count; step++) {  // In data-flow order
+            int i = j->reverse ? j->count - 1 - step : step;  // Stage index
+            if (j->stages[i].status) status = j->stages[i].status;  // Keep the latest failure
         }
     }
+    return status;              // Job status
+}
+
+void json_string(FILE *out, const char *text) {  // Writes text as a quoted JSON string
+    fputc('"', out);            // Open quote
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++) {  // Each byte
+        if (*c == '"' || *c == '\\') fprintf(out, "\\%c", *c);  // Escape quotes and backslashes
+        else if (*c < 0x20) fprintf(out, "\\u%04x", *c);  // And control characters
+        else fputc(*c, out);    // Everything else as is
+    }
+    fputc('"', out);            // Close quote
+}
+
+long long timeval_us(struct timeval tv) {  // rusage time in microseconds
+    return tv.tv_sec * 1000000LL + tv.tv_usec;  // Convert
+}
 
-    for (int i = 0; i < 2 * num_pipes; i++) close(pipefd[i]);  // Parent closes all pipe ends
-    for (int i = 0; i <= num_pipes; i++) wait(NULL);  // Wait for all children to finish
+void stats_write(job_stage *stages, int count, int id, int status, int in_process) {  // Sends one JSON record to the stats stream
+    char *buf;                  // Record text
+    size_t size;                // Its length
+    FILE *out = open_memstream(&buf, &size);  // Build it in memory so it goes out in one write
+    long long start = 0, end = 0;  // Span of the whole command
+    for (int i = 0; i < count; i++) {  // Stages that ran
+        if (stages[i].pid <= 0) continue;  // Never started
+        if (!start || stages[i].start_ns < start) start = stages[i].start_ns;  // Earliest launch
+        if (stages[i].end_ns > end) end = stages[i].end_ns;  // Latest exit
+    }
+    struct timespec now;        // Wall-clock time of the record
+    clock_gettime(CLOCK_REALTIME, &now);  // For lining records up with other data
+    fprintf(out, "{\"time_ms\":%lld,\"shell_pid\":%d,\"job\":%d,\"in_process\":%s,\"status\":%d,\"wall_us\":%lld,\"stages\":[",
+            now.tv_sec * 1000LL + now.tv_nsec / 1000000, (int)getpid(), id, in_process ? "true" : "false", status, (end - start) / 1000);  // Command fields
+    for (int i = 0; i < count; i++) {  // One object per stage, in command-line order
+        job_stage *st = &stages[i]; // This stage
+        fprintf(out, "%s{\"cmd\":", i ? "," : "");  // Separator
+        json_string(out, st->label ? st->label : "");  // What it ran
+        fprintf(out, ",\"pid\":%d,\"status\":%d,\"spawn_us\":%lld,\"spawn_to\":\"%s\",\"wall_us\":%lld,\"user_us\":%lld,\"sys_us\":%lld,"
+                     "\"maxrss_kb\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld}",
+                (int)st->pid, st->status, st->spawn_ns / 1000, in_process ? "none" : st->spawn_exec ? "exec" : "fork", st->pid > 0 ? (st->end_ns - st->start_ns) / 1000 : 0,
+                timeval_us(st->usage.ru_utime), timeval_us(st->usage.ru_stime),
+                st->usage.ru_maxrss, st->usage.ru_nvcsw, st->usage.ru_nivcsw);  // Timings and rusage
+    }
+    fputs("]}\n", out);         // End of the record
+    fclose(out);                // Finish the text
+    for (size_t off = 0; off < size; ) {  // One write in practice (O_APPEND keeps records whole)
+        ssize_t n = write(stats_fd, buf + off, size - off);  // Send it
+        if (n < 0 && errno == EINTR) continue;  // Interrupted
+        if (n <= 0) break;      // Stream is gone; drop the record
+        off += n;               // Sent this much
+    }
+    free(buf);                  // Release the text
 }
 
-void execute_reverse_piped_commands(char ***commands, int num_pipes) {  // Handles reverse piped commands
-    if (num_pipes >= MAX_PIPES) {  // Check if we have too many pipes
-        fprintf(stderr, "Maximum %d reverse pipes allowed\n", MAX_PIPES - 1);  // Complain if so
-        return;                    // Stop processing
+void job_remove(job *j) {       // Forgets a finished job
+    if (stats_fd >= 0 && !j->remaining) stats_write(j->stages, j->count, j->id, job_status(j), 0);  // Report it first
+    for (job **link = &job_list; *link; link = &(*link)->next) {  // Find it
+        if (*link == j) { *link = j->next; break; }  // Unlink it
+    }
+    for (int i = 0; i < j->count; i++) {  // Each stage
+        if (j->stages[i].pidfd >= 0) close(j->stages[i].pidfd);  // Drop its pidfd
+        free(j->stages[i].label);  // And its stats label
     }
+    free(j->stages);            // Free its stages
+    free(j->text);              // Its text
+    free(j);                    // And the job
+}
 
-    int pipefd[2 * num_pipes];     // Array for pipe file descriptors
-    for (int i = 0; i < num_pipes; i++) {  // Create all needed pipes
-        if (pipe(pipefd + i * 2) < 0) {  // Try to create a pipe
-            perror("pipe failed"); // Report if it fails
-            return;                // Stop processing
+void jobs_reap_nohang(void) {   // Collects any stage that already exited, without blocking
+    for (job *j = job_list; j; j = j->next) {  // Every job
+        for (int i = 0; i < j->count && j->remaining; i++) {  // Every running stage
+            job_collect(&j->stages[i], WNOHANG);  // Reap it if it's done
         }
     }
+}
+
+int event_watch(job_stage *s) { // Registers a running stage's pidfd with the event loop, 0 or -1
+    if (s->pidfd >= 0) return 0;  // Already watched
+    int fd = syscall(SYS_pidfd_open, s->pid, 0);  // Handle that becomes readable when the child exits (close-on-exec)
+    if (fd < 0) {               // No pidfd
+        if (errno == ENOSYS) pidfd_supported = 0;  // Old kernel: fall back to blocking waits
+        return -1;              // Could not watch it
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = s};  // Event points straight at the stage
+    epoll_ctl(event_fd, EPOLL_CTL_ADD, fd, &ev);  // Watch it
+    s->pidfd = fd;              // Remember it
+    return 0;                   // Watched
+}
 
-    pid_t pid;                     // Process ID variable
-    for (int i = num_pipes; i >= 0; i--) {  // For each command, in reverse order
-        int argc = 0;              // Counter for arguments
-        while (commands[i][argc]) argc++;  // Count arguments for this command
-        if (!validate_argc(argc)) {  // Check if argument count is valid
-            fprintf(stderr, "Command %d: Argument count must be between 1 and %d\n", num_pipes - i + 1, MAX_ARGS);  // Complain if not
-            return;                // Stop processing
+int event_loop(job *until, int input_fd) {  // Reaps children until `until` finishes (returns 0) or input_fd is readable (returns 1);
+                                            // with neither, returns after the next batch of exits
+    static int input_watched = -1;  // Input fd already in the epoll set
+    if (event_fd < 0) event_fd = epoll_create1(EPOLL_CLOEXEC);  // Create the loop on first use
+    if (input_fd >= 0 && input_watched != input_fd) {  // Watch the terminal too
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};  // NULL marks input
+        epoll_ctl(event_fd, EPOLL_CTL_ADD, input_fd, &ev);  // Add it
+        input_watched = input_fd;  // Only once
+    }
+    while (1) {                 // Until something the caller wants happens
+        if (until && until->remaining == 0) return 0;  // Job finished
+        for (job *j = job_list; j && pidfd_supported; j = j->next) {  // Watch every running stage
+            for (int i = 0; i < j->count; i++) if (!j->stages[i].done) event_watch(&j->stages[i]);  // Lazily open pidfds
+        }
+        if (!pidfd_supported) { // Fallback without pidfds
+            jobs_reap_nohang(); // Pick up finished background stages
+            if (input_fd >= 0) return 1;  // Just read input; the next sweep reaps the rest
+            if (!until) {       // "Any child" mode: block on the oldest running stage
+                for (job *j = job_list; j; j = j->next) {  // Oldest job first
+                    for (int i = 0; i < j->count; i++) {  // Its stages
+                        if (job_collect(&j->stages[i], 0)) return 0;  // Reaped one
+                    }
+                }
+                return 0;       // Nothing running
+            }
+            for (int i = 0; i < until->count; i++) job_collect(&until->stages[i], 0);  // Block on exactly this job's PIDs
+            return 0;           // Job finished
+        }
+        struct epoll_event events[32];  // Ready handles
+        int n = epoll_wait(event_fd, events, 32, -1);  // Sleep until a child exits or input arrives
+        if (n < 0 && errno != EINTR) { perror("epoll_wait failed"); return until ? 0 : 1; }  // Should not happen
+        int input_ready = 0;    // Terminal became readable
+        for (int i = 0; i < n; i++) {  // Each ready handle
+            job_stage *s = events[i].data.ptr;  // Stage, or NULL for input
+            if (!s) input_ready = 1;  // Input waiting
+            else job_collect(s, WNOHANG);  // Reap exactly this PID
         }
+        if (input_ready) return 1;  // Let the caller read
+        if (!until && input_fd < 0 && n > 0) return 0;  // "Any child" mode: something was reaped
+    }
+}
+
+void jobs_reset_in_child(void) {  // A forked subshell starts with no jobs and its own event loop
+    if (event_fd >= 0) close(event_fd);  // Parent's epoll instance is shared after fork
+    event_fd = -1;              // Child creates its own on demand
+    job_list = NULL;            // Parent's jobs are not ours to reap (memory is the child's copy)
+    next_job_id = 1;            // Fresh numbering
+    pipe_meters_close_in_child();  // Nor the parent's meter pumps
+}
+
+int job_wait(job *j) {          // Waits for a job and returns its status (the job stays listed)
+    if (job_list == j && !j->next && (stats_fd < 0 || j->count == 1)) {  // Nothing else running: plain blocking waits are cheapest
+        for (int i = 0; i < j->count; i++) job_collect(&j->stages[i], 0);  // Each stage, by PID
+    } else {                    // Background jobs too (or stats need each exit time): one loop reaps everything as it exits
+        event_loop(j, -1);      // Until this job is done
+    }
+    return job_status(j);       // Its status
+}
+
+void describe_word(FILE *out, const char *word) {  // Writes a word, turning $(...) marks back into text
+    int quoted = 0;             // Inside "$(...)"
+    for (; *word; word++) {     // Each character
+        if (*word == SUBST_OPEN[0]) fputs("$(", out);  // Unquoted substitution
+        else if (*word == SUBST_QUOTED[0]) fputs("\"$(", out), quoted = 1;  // Quoted one
+        else if (*word == SUBST_CLOSE[0]) fputs(quoted ? ")\"" : ")", out), quoted = 0;  // End of either
+        else if (*word == GLOB_MARK[0]) continue;  // Glob marks are not text
+        else fputc(*word, out); // Ordinary text
+    }
+}
+
+void describe_node(FILE *out, node *n) {  // Writes a node back out as command text
+    switch (n->type) {          // By node kind
+        case NODE_COMMAND:      // Words and redirections
+            for (int i = 0; i < n->count; i++) fputs(i ? " " : "", out), describe_word(out, n->argv[i]);  // Words
+            for (redirect *r = n->redirs; r; r = r->next)  // Redirections
+                fprintf(out, " %s ", r->fd == STDIN_FILENO ? "<" : (r->flags & O_APPEND) ? ">>" : ">"), describe_word(out, r->path);  // Operator and file
+            break;
+        case NODE_PIPELINE: case NODE_FANOUT: case NODE_CONDITIONAL: case NODE_SEQUENCE:  // Lists of children
+            for (int i = 0; i < n->count; i++) {  // Each child
+                if (i) fprintf(out, " %s ", n->type == NODE_PIPELINE ? (n->reverse ? "=" : "|") : n->type == NODE_FANOUT ? "|>" :  // Separator
+                                            n->type == NODE_CONDITIONAL ? n->operators[i - 1] : ";");
+                describe_node(out, n->items[i]);  // The child
+            }
+            break;
+    }
+}
+
+char *node_text(node *n) {      // A node as malloc'd command text
+    char *text;                 // The text
+    size_t size;                // Its length
+    FILE *out = open_memstream(&text, &size);  // Build the text in a malloc'd buffer
+    describe_node(out, n);      // Write the command
+    fclose(out);                // Finish the text
+    return text;                // Caller frees it
+}
 
-        pid = fork();              // Create a new process
-        if (pid == 0) {            // In the child process
-            if (i < num_pipes) dup2(pipefd[i * 2], STDIN_FILENO);  // Connect input from next pipe
-            if (i > 0) dup2(pipefd[(i - 1) * 2 + 1], STDOUT_FILENO);  // Connect output to previous pipe
-            for (int j = 0; j < 2 * num_pipes; j++) close(pipefd[j]);  // Close all pipe ends
-            handle_redirection(commands[i]);  // Set up any additional redirection
-            execvp(commands[i][0], commands[i]);  // Execute the command
-            perror("execvp failed");  // If we get here, exec failed
-            exit(1);                  // Exit child with error
-        } else if (pid < 0) {         // If fork failed
-            perror("fork failed");    // Report the error
-            return;                   // Stop processing
+void job_background(job *j, node *n) {  // Turns a just-launched job into a numbered background job
+    j->text = node_text(n);     // Command as jobs shows it
+    j->id = next_job_id++;      // Give it a number
+    for (int i = j->count - 1; i >= 0 && interactive; i--) {  // Report it like other shells
+        if (j->stages[i].pid > 0) { printf("[%d] %d\n", j->id, j->stages[i].pid); break; }  // Job number and a PID
+    }
+}
+
+void jobs_notify(void) {        // Reports and forgets finished background jobs (before each prompt or line)
+    if (!job_list) return;      // Nothing to do
+    jobs_reap_nohang();         // Catch up without blocking
+    for (job *j = job_list, *next; j; j = next) {  // Every job
+        next = j->next;         // Removal unlinks j
+        if (!j->id || j->remaining) continue;  // Still running (or foreground)
+        int status = job_status(j);  // How it ended
+        if (interactive) {      // Only terminals get notices
+            if (status) printf("[%d]  Exit %d\t%s\n", j->id, status, j->text);  // Failed
+            else printf("[%d]  Done\t%s\n", j->id, j->text);  // Succeeded
         }
+        job_remove(j);          // Forget it
     }
+}
 
-    for (int i = 0; i < 2 * num_pipes; i++) close(pipefd[i]);  // Parent closes all pipe ends
-    for (int i = 0; i <= num_pipes; i++) wait(NULL);  // Wait for all children to finish
+job *job_find(const char *spec) {  // Background job by %N, PID, or most recent when spec is NULL
+    job *found = NULL;          // Match
+    for (job *j = job_list; j; j = j->next) {  // Every job
+        if (!j->id) continue;   // Skip foreground jobs
+        if (!spec) found = j;   // Most recent wins
+        else if (spec[0] == '%' && atoi(spec + 1) == j->id) return j;  // %N
+        else for (int i = 0; i < j->count; i++) if (j->stages[i].pid == atoi(spec)) return j;  // PID
+    }
+    return found;               // Match or NULL
 }
 
-void execute_sequential_commands(char ***commands, int num_commands) {  // Runs commands one after another
-    if (num_commands > 4) {     // Check if we have too many commands
-        fprintf(stderr, "Maximum 4 sequential commands allowed\n");  // Complain if so
-        return;                 // Stop processing
+int jobs_builtin(char **args) { // jobs: lists background jobs
+    (void)args;                 // No options
+    jobs_reap_nohang();         // Bring states up to date
+    for (job *j = job_list, *next; j; j = next) {  // Every job
+        next = j->next;         // Removal unlinks j
+        if (!j->id) continue;   // Skip foreground jobs
+        if (j->remaining) printf("[%d]  Running\t%s\n", j->id, j->text);  // Still going
+        else {                  // Finished: report once and forget
+            printf("[%d]  Done\t%s\n", j->id, j->text);  // Report it
+            job_remove(j);      // Forget it
+        }
     }
+    return 0;                   // Always succeeds
+}
 
-    for (int i = 0; i < num_commands; i++) {  // For each command
-        int argc = 0;           // Counter for arguments
-        while (commands[i][argc]) argc++;  // Count arguments
-        if (!validate_argc(argc)) {  // Check if argument count is valid
-            fprintf(stderr, "Command %d: Argument count must be between 1 and %d\n", i + 1, MAX_ARGS);  // Complain if not
-            continue;           // Skip this command
+int wait_builtin(char **args) { // wait [%N|pid]: waits for one or all background jobs
+    if (args[1]) {              // A specific job
+        job *j = job_find(args[1]);  // Look it up
+        if (!j) { fprintf(stderr, "wait: %s: no such job\n", args[1]); return 127; }  // Unknown
+        int status = job_wait(j);  // Wait for it
+        job_remove(j);          // Forget it
+        return status;          // Its status
+    }
+    int status = 0;             // Status of the last job waited for
+    job *j;                     // Current job
+    while ((j = job_find(NULL))) {  // Until none are left
+        status = job_wait(j);   // Wait for it
+        job_remove(j);          // Forget it
+    }
+    return status;              // Last status
+}
+
+int fg_builtin(char **args) {   // fg [%N|pid]: waits for a background job in the foreground
+    job *j = job_find(args[1]); // Most recent by default
+    if (!j) { fprintf(stderr, "fg: %s: no such job\n", args[1] ? args[1] : "current"); return 1; }  // Unknown
+    printf("%s\n", j->text);    // Show what is now in the foreground
+    fflush(stdout);             // Before the job writes anything else
+    int status = job_wait(j);   // Wait for it
+    job_remove(j);              // Forget it
+    return status;              // Its status
+}
+
+int set_builtin(char **args) {  // set -o|+o pipefail|pipepacket|pipemeter, set -o pipesize|capturememfd|memosize SIZE, set +o pipesize|capturememfd
+    if (!args[1] || !args[2]) { // No option named: show settings
+        printf("pipefail\t%s\n", pipefail_enabled ? "on" : "off");  // Exit status of pipelines
+        printf("pipemeter\t%s\n", pipe_session.meter ? "on" : "off");  // Byte counts between stages
+        printf("pipepacket\t%s\n", pipe_session.packet ? "on" : "off");  // O_DIRECT pipes
+        if (pipe_session.size) printf("pipesize\t%d\n", pipe_session.size);  // Resized pipes
+        else printf("pipesize\tdefault\n");  // Kernel default
+        if (capture_memfd_threshold) printf("capturememfd\t%ld\n", capture_memfd_threshold);  // Big captures go to a memfd
+        else printf("capturememfd\toff\n");  // Always in the arena
+        printf("memosize\t%ld\n", memo_size_cap);  // memo store cap
+        return 0;               // Done
+    }
+    int on = strcmp(args[1], "-o") == 0;  // -o turns it on, +o off
+    if (!on && strcmp(args[1], "+o") != 0) args[2] = "";  // Neither -o nor +o: fall through to usage
+    if (strcmp(args[2], "pipefail") == 0) pipefail_enabled = on;  // Any failing stage fails the pipeline
+    else if (strcmp(args[2], "pipepacket") == 0) pipe_session.packet = on;  // Packet-mode pipes
+    else if (strcmp(args[2], "pipemeter") == 0) pipe_session.meter = on;  // Meter every boundary
+    else if (strcmp(args[2], "pipesize") == 0) {  // Pipe capacity
+        long size = !on ? 0 : args[3] ? pipe_size_parse(args[3]) : -1;  // +o goes back to the default
+        if (size < 0) {         // Missing or bad size
+            fprintf(stderr, "set: pipesize: expected bytes, NNk, NNm or max\n");  // Explain
+            return 2;           // Usage error
+        }
+        pipe_session.size = size;  // Every later pipeline uses it
+    } else if (strcmp(args[2], "memosize") == 0) {  // memo store cap
+        long size = on && args[3] ? size_parse(args[3]) : -1;  // Always needs a size
+        if (size < 0) {         // Missing or bad size
+            fprintf(stderr, "set: memosize: expected bytes, NNk, NNm or NNg\n");  // Explain
+            return 2;           // Usage error
         }
-        execute_command(commands[i]);  // Run the command
+        memo_size_cap = size;   // Later stores evict down to it
+    } else if (strcmp(args[2], "capturememfd") == 0) {  // memfd threshold for $(...)
+        long size = !on ? 0 : args[3] ? size_parse(args[3]) : -1;  // +o keeps every capture in the arena
+        if (size < 0) {         // Missing or bad size
+            fprintf(stderr, "set: capturememfd: expected bytes, NNk, NNm or NNg\n");  // Explain
+            return 2;           // Usage error
+        }
+        capture_memfd_threshold = size;  // Later substitutions use it
+    } else {                    // Unknown option
+        fprintf(stderr, "set: usage: set -o|+o pipefail|pipepacket|pipemeter, set -o pipesize SIZE|max, set -o capturememfd|memosize SIZE, set +o pipesize|capturememfd\n");  // Explain usage
+        return 2;               // Usage error
     }
+    return 0;                   // Done
 }
 
-void execute_conditional_commands(char ***commands, int num_commands, char **operators) {  // Handles && and || commands
-    if (num_commands > MAX_COMMANDS) {  // Check if we have too many commands
-        fprintf(stderr, "Maximum %d conditional commands allowed\n", MAX_COMMANDS);  // Complain if so
-        return;                 // Stop processing
+// Glob Expansion
+// The lexer puts GLOB_MARK in front of every unquoted * ? [ ] { } and , so
+// quoted ones stay literal. Just before a command runs, braces are expanded,
+// then each word with a * ? or [ is matched against the filesystem. The walk
+// goes one directory at a time with openat() from the parent's descriptor
+// and large getdents64 batches. Path strings are only built for directories
+// entered and for matches. A pattern with ** spreads its directories over a
+// small work-stealing pool. Every match is copied into one block of the line
+// arena, sorted, and handed to the executor as argv. A pattern that matches
+// nothing is left as typed, as in other shells.
+#define GLOB_SCAN_BUF (256 * 1024)  // getdents64 batch per worker
+#define GLOB_THREADS_MAX 8      // Workers for ** walks
+
+typedef struct {                // One name in a pool of names
+    uint32_t off;               // Offset of the name in the pool
+    unsigned char type;         // d_type (DT_DIR, DT_LNK, DT_UNKNOWN, ...)
+} dir_name;
+
+void dir_names_sort(dir_name *names, int n, const char *pool, int depth) {  // Sorts names by bytes (C locale), all equal before depth
+    while (n > 12) {            // Three-way radix quicksort: shared prefixes are compared once, not at every level
+        #define NAME_BYTE(i) ((unsigned char)pool[names[i].off + depth])  // Byte at the current depth
+        dir_name t;             // Swap temporary
+        #define NAME_SWAP(i, j) (t = names[i], names[i] = names[j], names[j] = t)  // Exchange two names
+        NAME_SWAP(0, n / 2);    // Middle element as pivot (directory order is already scrambled)
+        int pivot = NAME_BYTE(0);  // Pivot byte
+        int lt = 0, gt = n - 1, i = 1;  // [0,lt) < pivot, [lt,i) == pivot, (gt,n) > pivot
+        while (i <= gt) {       // Partition on the byte
+            int c = NAME_BYTE(i);  // This name's byte
+            if (c < pivot) NAME_SWAP(lt, i), lt++, i++;  // Smaller
+            else if (c > pivot) NAME_SWAP(i, gt), gt--;  // Larger
+            else i++;           // Equal
+        }
+        #undef NAME_BYTE
+        #undef NAME_SWAP
+        dir_names_sort(names, lt, pool, depth);  // Smaller bytes
+        dir_names_sort(names + gt + 1, n - gt - 1, pool, depth);  // Larger bytes
+        if (!pivot) return;     // Equal names ended here: nothing left to order
+        names += lt, n = gt + 1 - lt, depth++;  // Equal bytes: continue one byte deeper
     }
+    for (int i = 1; i < n; i++) {  // Small ranges: insertion sort
+        dir_name x = names[i];  // Name to place
+        int j = i;              // Where it goes
+        while (j && strcmp(pool + names[j - 1].off + depth, pool + x.off + depth) > 0) names[j] = names[j - 1], j--;  // Shift larger names up
+        names[j] = x;           // Place it
+    }
+}
 
-    int status;                 // To store command exit status
-    int prev_success = 1;       // Tracks if previous command succeeded
+int glob_is_active(const char *p) {  // Whether a word has an unquoted * ? or [
+    for (; (p = strchr(p, GLOB_MARK[0])); p += 2)  // Each marked character
+        if (p[1] == '*' || p[1] == '?' || p[1] == '[') return 1;  // Pattern character
+    return 0;                   // Only braces, commas or nothing
+}
 
-    for (int i = 0; i < num_commands; i++) {  // For each command
-        int argc = 0;           // Counter for arguments
-        while (commands[i][argc]) argc++;  // Count arguments
-        if (!validate_argc(argc)) {  // Check if argument count is valid
-            fprintf(stderr, "Command %d: Argument count must be between 1 and %d\n", i + 1, MAX_ARGS);  // Complain if not
-            return;             // Stop processing
-        }
-
-        if (i == 0 || (prev_success && strcmp(operators[i - 1], "&&") == 0) ||  // Should we run this command?
-            (!prev_success && strcmp(operators[i - 1], "||") == 0)) {
-            pid_t pid = fork();  // Create a new process
-            if (pid == 0) {      // In the child process
-                handle_redirection(commands[i]);  // Set up redirection
-                execvp(commands[i][0], commands[i]);  // Execute the command
-                perror("exec failed");  // If we get here, exec failed
-                exit(1);            // Exit child with error
-            } else if (pid > 0) {   // In the parent process
-                wait(&status);      // Wait for child and get status
-                prev_success = (WIFEXITED(status) && WEXITSTATUS(status) == 0);  // Did it succeed?
-            } else {               // If fork failed
-                perror("fork failed");  // Report the error
-                return;             // Stop processing
-            }
-        } else {               // If we shouldn't run this command
-            break;             // Stop the loop
+char *glob_literal(arena *a, const char *word) {  // Word with its marks removed
+    if (!strchr(word, GLOB_MARK[0])) return (char *)word;  // Nothing to remove
+    char *out = arena_alloc(a, strlen(word) + 1), *o = out;  // Never longer
+    for (; *word; word++) if (*word != GLOB_MARK[0]) *o++ = *word;  // Copy everything else
+    *o = '\0';                  // Terminate it
+    return out;                 // Literal text
+}
+
+int glob_class(const char *p, unsigned char c, const char **end) {  // Matches c against the set after [, 1 or 0; -1 if there is no closing ]
+    int negate = *p == '!' || *p == '^';  // [!...] and [^...]
+    if (negate) p++;            // Skip it
+    int found = 0, first = 1;   // Matched, still at the first member (where ] is literal)
+    while (*p) {                // Members
+        if (p[0] == GLOB_MARK[0] && p[1] == ']' && !first) { *end = p + 2; return found != negate; }  // Closing ]
+        if (*p == GLOB_MARK[0]) p++;  // A marked character inside [] is just itself
+        unsigned char lo = *p++, hi = lo;  // One character, or a range
+        if (p[0] == '-' && p[1] && !(p[1] == GLOB_MARK[0] && p[2] == ']')) {  // lo-hi
+            p++;                // Skip the -
+            if (*p == GLOB_MARK[0]) p++;  // Marked upper bound
+            hi = *p++;          // Upper bound
         }
+        if (c >= lo && c <= hi) found = 1;  // In the set
+        first = 0;              // ] closes from now on
     }
+    return -1;                  // Unterminated: [ is literal
 }
 
-// File Operations
-void execute_file_operations(char **args) {  // Handles special file operations
-    int argc = 0;            // Counter for arguments
-    while (args[argc]) argc++;  // Count arguments
+int glob_match(const char *p, const char *s) {  // Matches a name against one marked pattern component
+    const char *star_p = NULL, *star_s = NULL;  // Where to resume after the last *
+    if (*s == '.' && *p != '.') return 0;  // Hidden names need an explicit leading dot
+    while (*s) {                // Each name character
+        if (p[0] == GLOB_MARK[0] && p[1] == '*') {  // Remember the * and try matching nothing first
+            star_p = p += 2, star_s = s;  // Resume point
+            continue;           // Go on with the rest of the pattern
+        }
+        const char *next = NULL;  // Pattern after this element if it matched
+        if (p[0] == GLOB_MARK[0] && p[1] == '?') next = p + 2;  // Any one character
+        else if (p[0] == GLOB_MARK[0] && p[1] == '[') {  // Character class
+            const char *end;    // After its ]
+            int r = glob_class(p + 2, *s, &end);  // Test it
+            if (r == 1) next = end;  // In the set
+            else if (r < 0 && *s == '[') next = p + 2;  // No ]: a literal [
+        } else if (*p) {        // Literal character (possibly a marked brace or comma)
+            int w = *p == GLOB_MARK[0] ? 2 : 1;  // Mark plus character, or just the character
+            if (p[w - 1] == *s) next = p + w;  // Same character
+        }
+        if (next) { p = next, s++; continue; }  // Matched one character
+        if (!star_p) return 0;  // No * to fall back on
+        p = star_p, s = ++star_s;  // Let the last * swallow one more character
+    }
+    while (p[0] == GLOB_MARK[0] && p[1] == '*') p += 2;  // Trailing *s match nothing
+    return !*p;                 // Whole pattern used
+}
 
-    if (strcmp(args[0], "#") == 0) {  // If we're counting words
-        if (argc != 2) {     // Check if we have exactly one filename
-            fprintf(stderr, "# requires exactly 1 file argument\n");  // Complain if not
-            return;          // Stop processing
-        }
-        FILE *file = fopen(args[1], "r");  // Open the file
-        if (!file) {         // If opening failed
-            perror("fopen failed");  // Report the error
-            return;          // Stop processing
-        }
-        int word_count = 0;  // Counter for words
-        char word[256];      // Buffer for reading words
-        while (fscanf(file, "%255s", word) == 1) word_count++;  // Count each word
-        fclose(file);        // Close the file
-        printf("%d\n", word_count);  // Print the word count
-    } else if (argc >= 3 && strcmp(args[1], "~") == 0) {  // If we're swapping file contents
-        if (argc != 3) {     // Check if we have exactly two filenames
-            fprintf(stderr, "~ requires exactly 2 file arguments\n");  // Complain if not
-            return;          // Stop processing
-        }
-        FILE *file1 = fopen(args[0], "a+");  // Open first file for reading and appending
-        FILE *file2 = fopen(args[2], "a+");  // Open second file for reading and appending
-        if (!file1 || !file2) {  // If either file failed to open
-            perror("fopen failed");  // Report the error
-            if (file1) fclose(file1);  // Close any opened file
-            if (file2) fclose(file2);  // Close any opened file
-            return;          // Stop processing
-        }
-
-        fseek(file1, 0, SEEK_END);  // Go to end of first file
-        long size1 = ftell(file1);  // Get its size
-        fseek(file1, 0, SEEK_SET);  // Back to start
-        char *buf1 = malloc(size1 + 1);  // Allocate buffer for contents
-        fread(buf1, 1, size1, file1);  // Read contents
-        buf1[size1] = '\0';    // Null terminate
-
-        fseek(file2, 0, SEEK_END);  // Go to end of second file
-        long size2 = ftell(file2);  // Get its size
-        fseek(file2, 0, SEEK_SET);  // Back to start
-        char *buf2 = malloc(size2 + 1);  // Allocate buffer for contents
-        fread(buf2, 1, size2, file2);  // Read contents
-        buf2[size2] = '\0';    // Null terminate
-
-        fprintf(file1, "%s", buf2);  // Write second file's contents to first
-        fprintf(file2, "%s", buf1);  // Write first file's contents to second
-
-        free(buf1);            // Free the first buffer
-        free(buf2);            // Free the second buffer
-        fclose(file1);         // Close first file
-        fclose(file2);         // Close second file
-    } else if (argc >= 3 && strcmp(args[1], "+") == 0) {  // If we're concatenating files
-        if (argc > MAX_ARGS + 1) {  // Check if we have too many files
-            fprintf(stderr, "+ supports up to %d files\n", MAX_ARGS);  // Complain if so
-            return;          // Stop processing
-        }
-        for (int i = 0; i < argc; i += 2) {  // For each file (skipping +)
-            FILE *file = fopen(args[i], "r");  // Open the file
-            if (!file) {     // If opening failed
-                perror("fopen failed");  // Report the error
-                continue;    // Skip to next file
+void glob_braces(arena *a, const char *word, ptr_list *out) {  // Pushes every brace expansion of word (still marked)
+    for (const char *open = word; (open = strstr(open, GLOB_MARK "{")); open += 2) {  // Each candidate {
+        ptr_list commas = {0};  // Top-level commas (any number)
+        int depth = 0;          // Nesting
+        const char *close = NULL;  // Matching }
+        for (const char *p = open + 2; *p && !close; p++) {  // Scan to the matching }
+            if (*p != GLOB_MARK[0]) continue;  // Only marked braces and commas count
+            p++;                // The marked character
+            if (*p == '{') depth++;  // Nested
+            else if (*p == '}' && depth) depth--;  // Nested one closed
+            else if (*p == '}') close = p - 1;  // Ours
+            else if (*p == ',' && !depth) list_push(a, &commas, (void *)(p - 1));  // Alternative boundary
+        }
+        if (!close) break;      // Unbalanced: no expansion at all
+        size_t head = open - word;  // Text before {
+        const char *tail = close + 2;  // Text after }
+        if (commas.count) {     // {a,b,c}
+            const char *start = open + 2;  // First alternative
+            for (int i = 0; i <= commas.count; i++) {  // Each alternative
+                const char *end = i < commas.count ? (const char *)commas.items[i] : close;  // Where it stops
+                char *w = arena_alloc(a, head + (end - start) + strlen(tail) + 1);  // head + alternative + tail
+                sprintf(w, "%.*s%.*s%s", (int)head, word, (int)(end - start), start, tail);  // Build it
+                glob_braces(a, w, out);  // Later braces too
+                start = end + 2; // Past the comma
             }
-            char c;          // Character buffer
-            while ((c = fgetc(file)) != EOF) putchar(c);  // Print each character
-            fclose(file);    // Close the file
+            return;             // All alternatives pushed
         }
+        char *range = strndup(open + 2, close - open - 2), *dots = strstr(range, "..");  // {x..y}
+        long lo = 0, hi = 0;    // Range ends
+        char *end1 = NULL, *end2 = NULL;  // Parse positions
+        int numeric = dots && (lo = strtol(range, &end1, 10), end1 == dots && end1 != range) &&
+                      (hi = strtol(dots + 2, &end2, 10), *end2 == '\0' && end2 != dots + 2);  // {1..10}
+        int letters = dots && dots == range + 1 && dots[2] && !dots[3] && isalpha((unsigned char)range[0]) && isalpha((unsigned char)dots[2]);  // {a..e}
+        if (letters) lo = range[0], hi = dots[2];  // Letter range
+        free(range);            // Done parsing
+        if (!numeric && !letters) continue;  // Plain {word}: literal, try the next {
+        for (long v = lo; lo <= hi ? v <= hi : v >= hi; v += lo <= hi ? 1 : -1) {  // Each value, either direction
+            char *w = arena_alloc(a, head + 24 + strlen(tail));  // head + value + tail
+            if (numeric) sprintf(w, "%.*s%ld%s", (int)head, word, v, tail);  // Number
+            else sprintf(w, "%.*s%c%s", (int)head, word, (int)v, tail);  // Letter
+            glob_braces(a, w, out);  // Later braces too
+        }
+        return;                 // All values pushed
+    }
+    list_push(a, out, (void *)word);  // No braces left
+}
+
+typedef struct glob_dir {       // Open directory shared by the tasks for its subdirectories
+    int fd;                     // Its descriptor
+    int refs;                   // Tasks still needing it (closed at zero)
+} glob_dir;
+
+typedef struct {                // One directory to read
+    glob_dir *parent;           // Directory to openat() from (NULL = open path directly)
+    char *path;                 // Path of this directory as it appears in results, ending in /
+    int comp;                   // Pattern component to match its entries against
+} glob_task;
+
+typedef struct {                // One worker of the walk
+    pthread_mutex_t lock;       // Guards the deque
+    glob_task *tasks;           // Deque: the owner works at the tail, thieves take from the head
+    int head, tail, cap;        // Live tasks are [head, tail)
+    char *pool;                 // Matches, NUL-separated
+    size_t pool_len, pool_cap;  // Bytes used and room
+    int matches;                // Number of matches in pool
+    char *buf;                  // getdents64 batch
+    pthread_t thread;           // Its thread (worker 0 is the calling thread)
+} glob_worker;
+
+typedef struct {                // A whole pattern walk
+    char **comps;               // Marked pattern components between slashes
+    int *literal;               // Component has no pattern characters
+    int *globstar;              // Component is exactly **
+    int ncomps;                 // How many
+    int dirs_only;              // Pattern ends in /: only directories match, and keep the /
+    glob_worker *workers;       // The pool
+    int nworkers;               // Its size
+    int pending;                // Tasks queued or running (the walk ends at zero)
+} glob_walk;
+
+void glob_push(glob_walk *g, glob_worker *w, glob_dir *parent, char *path, int comp) {  // Queues a directory on a worker's deque
+    if (parent) __atomic_add_fetch(&parent->refs, 1, __ATOMIC_RELAXED);  // Keep the parent open for it
+    __atomic_add_fetch(&g->pending, 1, __ATOMIC_RELAXED);  // One more to finish
+    pthread_mutex_lock(&w->lock);  // Own the deque
+    if (w->tail == w->cap) {    // Out of room at the tail
+        memmove(w->tasks, w->tasks + w->head, (w->tail - w->head) * sizeof(glob_task));  // Reclaim the head first
+        w->tail -= w->head, w->head = 0;  // Shifted down
+        if (w->tail == w->cap) w->cap = w->cap ? w->cap * 2 : 64, w->tasks = realloc(w->tasks, w->cap * sizeof(glob_task));  // Still full: grow
     }
+    w->tasks[w->tail++] = (glob_task){parent, path, comp};  // Queue it
+    pthread_mutex_unlock(&w->lock);  // Release the deque
 }
 
-// Placeholder for builtin commands
-void handle_builtin(char **args) {  // Placeholder for future built-in commands
-    printf("Built-in commands not implemented\n");  // Just says it's not implemented
+void glob_dir_release(glob_dir *d) {  // Drops one task's hold on a directory
+    if (d && __atomic_sub_fetch(&d->refs, 1, __ATOMIC_ACQ_REL) == 0) close(d->fd), free(d);  // Last one closes it
 }
 
-// Command Parser and Executor
-void parse_and_execute(char *input) {  // Main function to parse and run commands
-    char *commands[MAX_COMMANDS];  // Array for command strings
-    char *operators[MAX_COMMANDS - 1];  // Array for operators between commands
-    int num_commands = 0;      // Counter for number of commands
-
-    // Parse commands and operators
-    char *token = input;       // Start with the full input
-    char *next_token;          // Pointer for next separator
-    while (token && num_commands < MAX_COMMANDS) {  // While we have input and room
-        next_token = strstr(token, ";");  // Look for sequential separator
-        if (!next_token) next_token = strstr(token, "&&");  // Look for AND
-        if (!next_token) next_token = strstr(token, "||");  // Look for OR
-
-        if (next_token) {      // If we found a separator
-            *next_token = '\0';  // Split the string here
-            commands[num_commands++] = token;  // Store this command
-            if (next_token[1] == '&') {  // If it's &&
-                operators[num_commands - 1] = "&&";  // Store the operator
-                token = next_token + 2;  // Move past &&
-            } else if (next_token[1] == '|') {  // If it's ||
-                operators[num_commands - 1] = "||";  // Store the operator
-                token = next_token + 2;  // Move past ||
-            } else {           // If it's just ;
-                operators[num_commands - 1] = ";";  // Store the operator
-                token = next_token + 1;  // Move past ;
+void glob_emit(glob_worker *w, const char *path, const char *name, int slash) {  // Records a match (slash: add a trailing /)
+    size_t n1 = strlen(path), n2 = strlen(name);  // Both parts
+    if (w->pool_len + n1 + n2 + 2 > w->pool_cap) {  // Out of room
+        w->pool_cap = (w->pool_len + n1 + n2 + 2) * 2;  // Grow
+        w->pool = realloc(w->pool, w->pool_cap);  // Resize
+    }
+    char *out = w->pool + w->pool_len;  // Where it goes
+    memcpy(out, path, n1);      // Directory part
+    memcpy(out + n1, name, n2); // Name
+    out[n1 + n2] = '/', out[n1 + n2 + slash] = '\0';  // Optional slash and NUL
+    w->pool_len += n1 + n2 + slash + 1;  // Advance
+    w->matches++;               // Count it
+}
+
+char *glob_join(const char *path, const char *name) {  // path + name + "/" for a subdirectory task
+    size_t n1 = strlen(path), n2 = strlen(name);  // Both parts
+    char *out = malloc(n1 + n2 + 2);  // Owned by the task
+    memcpy(out, path, n1), memcpy(out + n1, name, n2);  // Join them
+    out[n1 + n2] = '/', out[n1 + n2 + 1] = '\0';  // Directory slash
+    return out;                 // New path
+}
+
+void glob_run_task(glob_walk *g, glob_worker *w, glob_task *t) {  // Reads one directory and queues or records what matches
+    int fd;                     // This directory
+    if (t->parent) {            // Relative to the parent: no path walk
+        size_t end = strlen(t->path) - 1, start = end;  // Its own name is the last component (before the trailing /)
+        while (start && t->path[start - 1] != '/') start--;  // Back to the previous slash
+        char name[NAME_MAX + 1];  // That name, terminated
+        snprintf(name, sizeof(name), "%.*s", (int)(end - start), t->path + start);  // Copy it
+        fd = openat(t->parent->fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);  // Open it
+    } else fd = open(*t->path ? t->path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);  // Starting directory
+    glob_dir_release(t->parent);  // Parent no longer needed by us
+    if (fd < 0) return;         // Unreadable or gone
+    glob_dir *self = malloc(sizeof(glob_dir));  // Shared by the subdirectory tasks
+    self->fd = fd, self->refs = 1;  // We hold it while reading
+    int c = t->comp;            // Component to handle
+    if (g->literal[c] && !g->globstar[c]) {  // Plain name: no need to list the directory
+        const char *lit = g->comps[c];  // Unmarked name
+        struct stat st;         // Does it exist?
+        if (c == g->ncomps - 1) {  // Last: a match if it exists
+            if (fstatat(fd, lit, &st, g->dirs_only ? 0 : AT_SYMLINK_NOFOLLOW) == 0 && (!g->dirs_only || S_ISDIR(st.st_mode))) glob_emit(w, t->path, lit, g->dirs_only);  // (a directory if it ends in /)
+        }
+        else if (fstatat(fd, lit, &st, 0) == 0 && S_ISDIR(st.st_mode)) glob_push(g, w, self, glob_join(t->path, lit), c + 1);  // Go into it
+        glob_dir_release(self); // Done with this directory
+        return;                 // Nothing to list
+    }
+    int match = g->globstar[c] ? c + 1 : c;  // Component names are matched against (** matches zero directories too)
+    long n;                     // Bytes returned
+    while ((n = syscall(SYS_getdents64, fd, w->buf, GLOB_SCAN_BUF)) > 0) {  // Large batches
+        for (long off = 0; off < n; ) {  // Each entry
+            struct dirent64 *e = (struct dirent64 *)(w->buf + off);  // Same layout as linux_dirent64
+            off += e->d_reclen; // Next one
+            const char *ename = e->d_name;  // Its name
+            if (ename[0] == '.' && (!ename[1] || (ename[1] == '.' && !ename[2]))) continue;  // . and ..
+            int type = e->d_type;  // Known from getdents64 on most filesystems
+            struct stat st;     // For the rest
+            if (type == DT_UNKNOWN && fstatat(fd, ename, &st, AT_SYMLINK_NOFOLLOW) == 0) type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK : DT_REG;  // Ask
+            if (g->globstar[c] && type == DT_DIR && ename[0] != '.')  // ** goes one level deeper (not through symlinks or hidden directories)
+                glob_push(g, w, self, glob_join(t->path, ename), c);  // Same component again below
+            if (match == g->ncomps) {  // ** was last: everything below matches
+                if (ename[0] != '.' && (!g->dirs_only || type == DT_DIR)) glob_emit(w, t->path, ename, g->dirs_only);  // Except hidden names
+                continue;       // Next entry
             }
-            while (*token == ' ') token++;  // Skip any spaces
-        } else {               // If no more separators
-            commands[num_commands++] = token;  // Store last command
-            break;             // Done parsing
+            if (!glob_match(g->comps[match], ename)) continue;  // Not this one
+            int is_dir = type == DT_DIR || (type == DT_LNK && fstatat(fd, ename, &st, 0) == 0 && S_ISDIR(st.st_mode));  // Directory (a link to one counts here)
+            if (match == g->ncomps - 1) { if (!g->dirs_only || is_dir) glob_emit(w, t->path, ename, g->dirs_only); }  // Last component: a result
+            else if (is_dir) glob_push(g, w, self, glob_join(t->path, ename), match + 1);  // Next component inside it
         }
     }
+    glob_dir_release(self);     // Subdirectory tasks may still hold it
+}
 
-    // Check for conditional operators
-    int has_conditional = 0;   // Flag for && or ||
-    for (int i = 0; i < num_commands - 1; i++) {  // Check each operator
-        if (strcmp(operators[i], "&&") == 0 || strcmp(operators[i], "||") == 0) {  // If conditional
-            has_conditional = 1;  // Set the flag
-            break;            // No need to check more
+int glob_take(glob_walk *g, glob_worker *w, glob_task *t) {  // Gets a task: own tail first, then steal a head; 0 when the walk is over
+    while (1) {                 // Until work or the end
+        pthread_mutex_lock(&w->lock);  // Own deque
+        int got = w->tail > w->head;  // Anything left?
+        if (got) *t = w->tasks[--w->tail];  // Newest: depth first keeps few directories open
+        pthread_mutex_unlock(&w->lock);  // Release it
+        if (got) return 1;      // Work
+        for (int i = 1; i < g->nworkers && !got; i++) {  // Try the others
+            glob_worker *v = &g->workers[(w - g->workers + i) % g->nworkers];  // Next victim
+            pthread_mutex_lock(&v->lock);  // Their deque
+            got = v->tail > v->head;  // Anything to take?
+            if (got) *t = v->tasks[v->head++];  // Oldest: the biggest unexplored subtree
+            pthread_mutex_unlock(&v->lock);  // Release it
         }
+        if (got) return 1;      // Stolen work
+        if (!__atomic_load_n(&g->pending, __ATOMIC_ACQUIRE)) return 0;  // Nothing queued or running anywhere
+        sched_yield();          // Someone is still reading a directory
     }
+}
 
-    if (has_conditional) {     // If we have && or ||
-        char ***cmd_args = malloc(num_commands * sizeof(char **));  // Allocate array for args
-        for (int i = 0; i < num_commands; i++) {  // For each command
-            cmd_args[i] = malloc((MAX_ARGS + 1) * sizeof(char *));  // Allocate args array
-            char *arg = strtok(commands[i], " ");  // Split by spaces
-            int argc = 0;      // Counter for arguments
-            while (arg && argc < MAX_ARGS) {  // While we have args and room
-                cmd_args[i][argc++] = arg;  // Store the argument
-                arg = strtok(NULL, " ");  // Get next argument
-            }
-            cmd_args[i][argc] = NULL;  // Null terminate the args array
-        }
-        execute_conditional_commands(cmd_args, num_commands, operators);  // Run conditional commands
-        for (int i = 0; i < num_commands; i++) free(cmd_args[i]);  // Free each args array
-        free(cmd_args);        // Free the main array
-    } else if (num_commands > 1 && strcmp(operators[0], ";") == 0) {  // If sequential commands
-        char ***cmd_args = malloc(num_commands * sizeof(char **));  // Allocate array for args
-        for (int i = 0; i < num_commands; i++) {  // For each command
-            cmd_args[i] = malloc((MAX_ARGS + 1) * sizeof(char *));  // Allocate args array
-            char *arg = strtok(commands[i], " ");  // Split by spaces
-            int argc = 0;      // Counter for arguments
-            while (arg && argc < MAX_ARGS) {  // While we have args and room
-                cmd_args[i][argc++] = arg;  // Store the argument
-                arg = strtok(NULL, " ");  // Get next argument
-            }
-            cmd_args[i][argc] = NULL;  // Null terminate the args array
-        }
-        execute_sequential_commands(cmd_args, num_commands);  // Run sequential commands
-        for (int i = 0; i < num_commands; i++) free(cmd_args[i]);  // Free each args array
-        free(cmd_args);        // Free the main array
-    } else {                   // Single command or piped commands
-        // Handle piped commands
-        char *pipe_commands[MAX_PIPES + 1];  // Array for piped command strings
-        int num_pipes = 0;     // Counter for pipes
-        int is_reverse = (strstr(input, "=") != NULL);  // Check for reverse pipe (using =)
-        char *pipe_cmd = strtok(commands[0], "|=");  // Split by | or =
-        while (pipe_cmd && num_pipes <= MAX_PIPES) {  // While we have commands and room
-            pipe_commands[num_pipes++] = pipe_cmd;  // Store the command
-            pipe_cmd = strtok(NULL, "|=");  // Get next command
-        }
-
-        if (num_pipes > 1) {   // If we have pipes
-            char ***piped_args = malloc(num_pipes * sizeof(char **));  // Allocate array for args
-            for (int j = 0; j < num_pipes; j++) {  // For each piped command
-                piped_args[j] = malloc((MAX_ARGS + 1) * sizeof(char *));  // Allocate args array
-                char *arg = strtok(pipe_commands[j], " ");  // Split by spaces
-                int argc = 0;  // Counter for arguments
-                while (arg && argc < MAX_ARGS) {  // While we have args and room
-                    piped_args[j][argc++] = arg;  // Store the argument
-                    arg = strtok(NULL, " ");  // Get next argument
-                }
-                piped_args[j][argc] = NULL;  // Null terminate the args array
+void *glob_worker_main(void *arg) {  // Runs tasks until the walk is over
+    glob_walk *g = ((void **)arg)[0];  // The walk
+    glob_worker *w = ((void **)arg)[1];  // This worker
+    glob_task t;                // Current task
+    while (glob_take(g, w, &t)) {  // Each directory
+        glob_run_task(g, w, &t);  // Read it
+        free(t.path);           // Its path was only needed for results
+        __atomic_sub_fetch(&g->pending, 1, __ATOMIC_ACQ_REL);  // Finished (its children were counted first)
+    }
+    return NULL;                // Done
+}
+
+int glob_expand(arena *a, const char *word, ptr_list *out) {  // Pushes the expansions of one marked word, returns how many
+    if (!strchr(word, GLOB_MARK[0])) { list_push(a, out, (void *)word); return 1; }  // Plain word
+    ptr_list words = {0};       // After brace expansion
+    glob_braces(a, word, &words);  // {a,b} and {1..5}
+    int total = 0;              // Words pushed
+    for (int wi = 0; wi < words.count; wi++) {  // Each brace result
+        char *pattern = words.items[wi];  // Still marked
+        if (!glob_is_active(pattern)) { list_push(a, out, glob_literal(a, pattern)); total++; continue; }  // No wildcards
+        glob_walk g = {0};      // The walk
+        char *copy = arena_alloc(a, strlen(pattern) + 1);  // Split into components in place
+        strcpy(copy, pattern);  // Copy it
+        int absolute = copy[0] == '/';  // Starts at the root
+        g.dirs_only = copy[strlen(copy) - 1] == '/';  // dir*/ matches directories only
+        for (char *p = copy; *p; p++) g.ncomps += *p == '/' && p[1] && p[1] != '/';  // Count components
+        g.ncomps += !absolute;  // The first one has no slash before it
+        g.comps = arena_alloc(a, g.ncomps * sizeof(char *));  // Component list
+        g.literal = arena_alloc(a, g.ncomps * sizeof(int));  // Plain-name flags
+        g.globstar = arena_alloc(a, g.ncomps * sizeof(int));  // ** flags
+        int nc = 0, has_globstar = 0;  // Components filled, any **
+        for (char *save, *c = strtok_r(copy, "/", &save); c; c = strtok_r(NULL, "/", &save)) {  // Each component
+            g.literal[nc] = !glob_is_active(c);  // Needs no listing
+            g.comps[nc] = g.literal[nc] ? glob_literal(a, c) : c;  // Plain names lose their marks, patterns keep them
+            g.globstar[nc] = strcmp(c, GLOB_MARK "*" GLOB_MARK "*") == 0;  // Exactly **
+            has_globstar |= g.globstar[nc++];  // Recursive walk
+        }
+        g.ncomps = nc;          // Exact count
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);  // Workers only pay off for ** over big trees
+        g.nworkers = has_globstar && cpus > 1 ? (cpus < GLOB_THREADS_MAX ? cpus : GLOB_THREADS_MAX) : 1;  // Pool size
+        g.workers = calloc(g.nworkers, sizeof(glob_worker));  // The pool
+        for (int i = 0; i < g.nworkers; i++) {  // Set each one up
+            pthread_mutex_init(&g.workers[i].lock, NULL);  // Its deque lock
+            g.workers[i].buf = malloc(GLOB_SCAN_BUF);  // Its batch buffer
+        }
+        glob_push(&g, &g.workers[0], NULL, strdup(absolute ? "/" : ""), 0);  // Start at / or the current directory
+        void *args[GLOB_THREADS_MAX][2];  // Arguments for each thread
+        int started = 1;        // Worker 0 is us
+        for (int i = 1; i < g.nworkers; i++) {  // Start the rest
+            args[i][0] = &g, args[i][1] = &g.workers[i];  // Walk and worker
+            if (pthread_create(&g.workers[i].thread, NULL, glob_worker_main, args[i]) != 0) break;  // The others cover for it
+            started++;          // Running
+        }
+        args[0][0] = &g, args[0][1] = &g.workers[0];  // This thread's share
+        glob_worker_main(args[0]);  // Work until the walk is over
+        for (int i = 1; i < started; i++) pthread_join(g.workers[i].thread, NULL);  // Wait for the others
+
+        size_t bytes = 0;       // All matches together
+        int count = 0;          // How many
+        for (int i = 0; i < g.nworkers; i++) bytes += g.workers[i].pool_len, count += g.workers[i].matches;  // Sum them
+        if (count) {            // Copy them into one arena block and sort them
+            char *pool = arena_alloc(a, bytes);  // Every match, NUL-separated
+            dir_name *names = malloc(count * sizeof(dir_name));  // Offsets to sort
+            size_t at = 0;      // Fill position
+            int k = 0;          // Names recorded
+            for (int i = 0; i < g.nworkers; i++) {  // Each worker's matches
+                memcpy(pool + at, g.workers[i].pool, g.workers[i].pool_len);  // One copy per worker
+                for (size_t o = at; o < at + g.workers[i].pool_len; o += strlen(pool + o) + 1) names[k++].off = o;  // Where each starts
+                at += g.workers[i].pool_len;  // Next worker's block
             }
-            if (is_reverse) execute_reverse_piped_commands(piped_args, num_pipes - 1);  // Run reverse pipes
-            else execute_piped_commands(piped_args, num_pipes - 1);  // Run normal pipes
-            for (int j = 0; j < num_pipes; j++) free(piped_args[j]);  // Free each args array
-            free(piped_args);  // Free the main array
-        } else {               // Single command
-            char *args[MAX_ARGS + 1];  // Array for arguments
-            int argc = 0;      // Counter for arguments
-            char *arg = strtok(commands[0], " ");  // Split by spaces
-            while (arg && argc < MAX_ARGS) {  // While we have args and room
-                args[argc++] = arg;  // Store the argument
-                arg = strtok(NULL, " ");  // Get next argument
+            dir_names_sort(names, count, pool, 0);  // Sorted like other shells (C locale)
+            for (int i = 0; i < count; i++) list_push(a, out, pool + names[i].off);  // Into argv
+            free(names);        // Offsets are no longer needed
+        } else list_push(a, out, glob_literal(a, pattern));  // No match: the word as typed
+        total += count ? count : 1;  // Words added
+        for (int i = 0; i < g.nworkers; i++) {  // Tear the pool down
+            pthread_mutex_destroy(&g.workers[i].lock);  // Its lock
+            free(g.workers[i].tasks), free(g.workers[i].pool), free(g.workers[i].buf);  // Its memory
+        }
+        free(g.workers);        // The pool itself
+    }
+    return total;               // Words pushed
+}
+
+// Command Substitution
+// The lexer leaves $(...) in a word as SUBST_OPEN/SUBST_QUOTED + raw text + SUBST_CLOSE.
+// Just before a command runs, each one is run in a subshell whose stdout is read
+// into the line arena with large reads (or, past `set -o capturememfd`, spliced
+// into a memfd and mapped), and the words are rebuilt in place.
+#define CAPTURE_CHUNK (64 * 1024) 
+
+char *capture_output(arena *a, const char *text, size_t *len_out) {  // Runs text in a subshell and returns its stdout, trailing newlines dropped
+    int pipefd[2];              // Subshell's stdout
+    *len_out = 0;               // Empty if anything fails
+    if (pipe2(pipefd, O_CLOEXEC) < 0) { perror("pipe failed"); return ""; }  // Nothing captured
+    fflush(stdout);             // Do not duplicate buffered output
+    long long started = now_ns();  // Spawn latency starts here
+    pid_t pid = fork();         // Subshell for the command
+    if (pid == 0) {             // In the subshell
+        jobs_reset_in_child();  // Do not touch the parent's jobs
+        dup2(pipefd[1], STDOUT_FILENO);  // Output goes to the capture
+        close(pipefd[0]), close(pipefd[1]);  // No exec here, so close-on-exec does not help
+        arena sub = {0};        // Subshell's own parse arena
+        const char *error = NULL;  // Syntax error, if any
+        node *tree = parse_line(&sub, text, &error);  // Parse the inner command
+        int status = 0;         // Its status
+        if (error) fprintf(stderr, "w25shell: %s\n", error), status = 2;  // Bad syntax
+        else if (tree) status = execute_node(tree);  // Run it
+        fflush(stdout);         // Push out its output
+        _exit(status);          // Leave with its status
+    }
+    close(pipefd[1]);           // Only the subshell writes
+    if (pid < 0) { perror("fork failed"); close(pipefd[0]); return ""; }  // Nothing captured
+    job *j = job_new(1, 0);     // Track it like any other job
+    job_add_pid(j, 0, pid, started);  // The subshell
+
+    size_t cap = CAPTURE_CHUNK, len = 0;  // Buffer size and bytes read
+    char *buf = arena_alloc(a, cap);  // Grows in the line arena
+    int memfd = -1;             // Backing file for big captures
+    while (1) {                 // Until EOF
+        if (capture_memfd_threshold && len > (size_t)capture_memfd_threshold &&
+            (memfd = memfd_create("w25-capture", MFD_CLOEXEC)) >= 0) {  // Too big for the arena: continue in a memfd
+            for (size_t off = 0; off < len; ) {  // What we already have
+                ssize_t n = write(memfd, buf + off, len - off);  // Copy it over once
+                if (n <= 0) break;  // Out of memory; the capture is cut short
+                off += n;       // Written this much
             }
-            args[argc] = NULL;  // Null terminate the args array
-
-            if (argc > 0) {     // If we have a command
-                if (strcmp(args[0], "#") == 0 || (argc > 1 && (strcmp(args[1], "~") == 0 || strcmp(args[1], "+") == 0))) {  // File operation?
-                    execute_file_operations(args);  // Handle file operation
-                } else if (strcmp(args[0], "killterm") == 0) {  // Kill current shell?
-                    killterm();     // Terminate current shell
-                } else if (strcmp(args[0], "killallterms") == 0) {  // Kill all shells?
-                    killallterms();  // Terminate all shells
-                } else {           // Regular command
-                    execute_command(args);  // Run the command
-                }
+            ssize_t n;          // Rest of the output goes straight from the pipe into the memfd
+            while ((n = splice(pipefd[0], NULL, memfd, NULL, 1 << 20, SPLICE_F_MOVE)) > 0 || (n < 0 && errno == EINTR)) {  // No trip through user space
+                if (n > 0) len += n;  // Count it
             }
+            break;              // All read
         }
+        if (len == cap) buf = arena_grow(a, buf, cap, cap * 2), cap *= 2;  // Double the buffer
+        ssize_t n = read(pipefd[0], buf + len, cap - len);  // Large reads
+        if (n < 0 && errno == EINTR) continue;  // Interrupted
+        if (n <= 0) break;      // EOF
+        len += n;               // Got more
+    }
+    close(pipefd[0]);           // Done reading
+    job_wait(j);                // Reap the subshell
+    job_remove(j);              // Forget it
+
+    if (memfd >= 0) {           // Map the memfd instead of copying it back
+        void *map = MAP_FAILED; // The mapping
+        if (ftruncate(memfd, len + 1) == 0)  // Room for the terminating NUL
+            map = mmap(NULL, len + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE, memfd, 0);  // Private: words are cut in place
+        close(memfd);           // The mapping keeps the data alive
+        if (map == MAP_FAILED) { perror("mmap failed"); return ""; }  // Capture lost
+        arena_map(a, map, len + 1);  // Unmapped with the rest of the line
+        buf = map;              // Use the mapping
+    } else if (len == cap) {    // No room for the NUL
+        buf = arena_grow(a, buf, cap, cap + 1);  // One more byte
     }
+    while (len && buf[len - 1] == '\n') len--;  // Trailing newlines are dropped
+    buf[len] = '\0';            // Terminate it
+    *len_out = len;             // Its length
+    return buf;                 // The output
 }
 
-// Main Shell Loop
-int main() {                   // Main function where everything starts
-    char input[MAX_CMD_LEN];   // Buffer for user input
-    while (1) {                // Infinite loop for shell prompt
-        printf("w25shell$ ");  // Show the prompt
-        fflush(stdout);        // Make sure prompt appears immediately
-        if (!fgets(input, MAX_CMD_LEN, stdin)) break;  // Read input, break on EOF
-        input[strcspn(input, "\n")] = 0;  // Remove newline from input
-        parse_and_execute(input);  // Process the command
+int is_ifs(char c) {            // Characters that separate fields in unquoted output
+    return c == ' ' || c == '\t' || c == '\n';  // Default IFS
+}
+
+void field_add(arena *a, char **field, size_t *len, size_t *cap, const char *text, size_t n) {  // Appends text to the field being built
+    if (*len + n + 1 > *cap) {  // Out of room
+        size_t bigger = (*len + n + 1) * 2;  // Grow geometrically
+        *field = arena_grow(a, *field, *cap, bigger);  // In place when it is the last allocation
+        *cap = bigger;          // New capacity
+    }
+    memcpy(*field + *len, text, n);  // Append
+    *len += n;                  // New length
+    (*field)[*len] = '\0';      // Keep it terminated
+}
+
+void expand_word(arena *a, char *word, ptr_list *out, int split) {  // Pushes the fields a word expands to
+    if (!strpbrk(word, SUBST_MARKS)) { list_push(a, out, word); return; }  // Nothing to expand
+    if (split && word[0] == SUBST_OPEN[0] && strchr(word, SUBST_CLOSE[0])[1] == '\0') {  // Just $(...): split the capture in place
+        *strchr(word, SUBST_CLOSE[0]) = '\0';  // End of the command text
+        size_t len;             // Capture length
+        char *p = capture_output(a, word + 1, &len);  // Run it
+        while (*p) {            // Each field
+            while (is_ifs(*p)) p++;  // Skip separators
+            if (!*p) break;     // Only separators left
+            list_push(a, out, p);  // Field starts here
+            while (*p && !is_ifs(*p)) p++;  // Find its end
+            if (*p) *p++ = '\0';  // Cut it off in the capture buffer itself
+        }
+        return;                 // No copies made
+    }
+    char *field = NULL;         // Field being built
+    size_t len = 0, cap = 0;    // Its length and capacity
+    int have = 0;               // Field exists even if empty (quoted text was seen)
+    for (char *p = word; *p; ) {  // Literal text and substitutions
+        if (*p != SUBST_OPEN[0] && *p != SUBST_QUOTED[0]) {  // Literal run
+            size_t n = strcspn(p, SUBST_MARKS);  // Up to the next substitution
+            field_add(a, &field, &len, &cap, p, n);  // Copy it
+            have = 1;           // Part of a field
+            p += n;             // Continue after it
+            continue;           // Next piece
+        }
+        int quoted = *p == SUBST_QUOTED[0] || !split;  // "$(...)" is never split
+        char *end = strchr(p, SUBST_CLOSE[0]);  // End of the command text
+        *end = '\0';            // Terminate it
+        size_t n;               // Capture length
+        char *text = capture_output(a, p + 1, &n);  // Run it
+        p = end + 1;            // Continue after it
+        if (quoted) {           // One piece of the current field
+            field_add(a, &field, &len, &cap, text, n);  // Append all of it
+            have = 1;           // Even if empty
+            continue;           // Next piece
+        }
+        for (size_t i = 0; i < n; ) {  // Split on IFS
+            if (is_ifs(text[i])) {  // Separator ends the current field
+                if (have) list_push(a, out, field);  // Emit it
+                field = NULL, len = cap = 0, have = 0;  // Start a new one
+                while (i < n && is_ifs(text[i])) i++;  // Skip the run
+                continue;       // Next field
+            }
+            size_t run = 0;     // Non-separator run
+            while (i + run < n && !is_ifs(text[i + run])) run++;  // Measure it
+            field_add(a, &field, &len, &cap, text + i, run);  // Append it
+            have = 1;           // Field has content
+            i += run;           // Continue after it
+        }
+    }
+    if (have) list_push(a, out, field ? field : "");  // Last field
+}
+
+void expand_command(node *cmd) {  // Runs a command's $(...) substitutions and globs, and rebuilds its words
+    arena *a = cmd->expand;     // Where the parser put this command
+    if (!a) return;             // Nothing to expand
+    cmd->expand = NULL;         // Only once
+    ptr_list words = {0};       // New argument vector
+    for (int i = 0; i < cmd->count; i++) {  // Each word
+        ptr_list fields = {0};  // After $(...) and splitting
+        expand_word(a, cmd->argv[i], &fields, 1);  // Substitute first
+        for (int f = 0; f < fields.count; f++) glob_expand(a, fields.items[f], &words);  // Then braces and wildcards
+    }
+    for (redirect *r = cmd->redirs; r; r = r->next) {  // Redirection targets are never split or globbed
+        ptr_list one = {0};     // Single field
+        expand_word(a, r->path, &one, 0);  // Expand it
+        r->path = one.count ? glob_literal(a, one.items[0]) : "";  // Use it as typed
+    }
+    if (!words.count) {         // Everything expanded to nothing
+        words.items = arena_alloc(a, sizeof(void *));  // Still a valid argv
+        words.items[0] = NULL;  // That is empty
+    }
+    cmd->argv = (char **)words.items;  // NULL-terminated argv
+    cmd->count = words.count;   // Number of words
+}
+
+// Command Execution Functions
+void launch_stages(job *j, int base, node **commands, int num_pipes, int reverse, int in_fd, int out_fd, const pipe_config *cfg) {  // Starts a linear pipeline as stages base.. of j
+    pipe_meter **meter_tail = &meter_list;  // Where the next pump goes
+    while (*meter_tail) meter_tail = &(*meter_tail)->next;  // After any from an earlier branch
+    int prev_read = in_fd;         // Read end of the pipe feeding the next stage (-1 = inherit stdin)
+    for (int step = 0; step <= num_pipes; step++) {  // Launch stages in data-flow order, one pipe open at a time
+        int i = reverse ? num_pipes - step : step;  // = pipelines flow from the rightmost command
+        int pipefd[2] = {-1, -1};  // Pipe to the next stage
+        int meterfd[2] = {-1, -1}; // Second pipe after a meter pump
+        if (step < num_pipes && (pipe_open(pipefd, cfg) < 0 || (cfg->meter && pipe_open(meterfd, cfg) < 0))) {  // Try to create the pipe(s)
+            perror("pipe failed"); // Report if it fails
+            if (pipefd[0] >= 0) close(pipefd[0]), close(pipefd[1]);  // Drop a half-made pair
+            break;                 // Stages already running see EOF
+        }
+        int stage_out = step < num_pipes ? pipefd[1] : out_fd;  // Last stage writes wherever the caller says
+        expand_command(commands[i]);  // Run any $(...) before launching the stage
+        long long started = now_ns();  // Spawn latency starts here
+        pid_t pid = is_shell_command(commands[i]) ? spawn_builtin(commands[i], prev_read, stage_out)  // Builtins get a child of their own
+                                                  : spawn_command(commands[i], prev_read, stage_out);  // Programs are spawned
+        job_add_pid(j, base + i, pid, started);  // Record this stage
+        j->stages[base + i].spawn_exec = !is_shell_command(commands[i]);  // Programs are timed to exec on either launch path
+        if (stats_fd >= 0) j->stages[base + i].label = node_text(commands[i]);  // Name it in stats records
+        if (prev_read >= 0 && prev_read != in_fd) close(prev_read);  // Stage owns its input now (the caller closes in_fd)
+        if (pipefd[1] >= 0) close(pipefd[1]);  // And its output
+        prev_read = pipefd[0];     // Next stage reads from here
+        if (meterfd[0] >= 0) {     // Pump between this stage and the next
+            pipe_meter *m = calloc(1, sizeof(pipe_meter));  // New boundary
+            m->in_fd = pipefd[0];  // Reads what this stage wrote
+            m->out_fd = meterfd[1];  // Writes what the next stage reads
+            m->from = commands[i]->argv[0] ? commands[i]->argv[0] : "(redirect)";  // Upstream name
+            m->to = commands[reverse ? i - 1 : i + 1]->argv[0];  // Downstream name
+            if (!m->to) m->to = "(redirect)";  // Redirection-only stage
+            *meter_tail = m;       // Keep launch order
+            meter_tail = &m->next; // Next one goes after it
+            prev_read = meterfd[0];  // Next stage reads the pump's output
+        }
+    }
+    if (prev_read >= 0 && prev_read != in_fd) close(prev_read);  // Only left open if we stopped early
+}
+
+int run_pipeline(node **commands, int num_pipes, int reverse, node *background, const pipe_config *tuning) {  // Launches every stage as one job; waits unless it goes to the background
+    job *j = job_new(num_pipes + 1, reverse);  // Job owning every stage's PID
+    pipe_config cfg = pipe_effective(tuning);  // Pipe size and modes for this pipeline
+    if (background) cfg.meter = 0; // Nobody is left to report a background pipeline's traffic
+    launch_stages(j, 0, commands, num_pipes, reverse, -1, -1, &cfg);  // Start them all
+    pipe_pumps_start();            // Then the meters
+
+    if (background) {              // Leave it running
+        job_background(j, background);  // Number it and remember its text
+        return 0;                  // Launching succeeded
+    }
+    int status = job_wait(j);      // Wait for exactly these PIDs
+    job_remove(j);                 // Forget the job
+    if (meter_list) pipe_meters_finish();  // Report bytes per boundary
+    return status;                 // Pipeline status
+}
+
+int execute_fanout(node *n) {      // producer |> branch |> ...: every branch reads its own copy of the producer's output
+    int branches = n->count - 1;   // Consumers
+    int total = 0;                 // Stages across producer and branches
+    for (int k = 0; k < n->count; k++) total += n->items[k]->type == NODE_PIPELINE ? n->items[k]->count : 1;  // Count them
+    job *j = job_new(total, 0);    // One job for the whole fan-out
+    pipe_config cfg = pipe_effective(n->items[0]->type == NODE_PIPELINE ? n->items[0]->tuning : NULL);  // Producer's pipe settings
+    // Hop k reads chain[k], tees it into chain[k + 1] and splices the same bytes into branch k's pipe.
+    // The last branch reads the end of the chain directly, so nothing is copied into user space.
+    int (*chain)[2] = calloc(branches, sizeof(*chain));  // chain[0] is fed by the producer
+    int (*feed)[2] = calloc(branches, sizeof(*feed));  // Input pipe of each branch but the last
+    fanout_link **tail = &fanout_list;  // Hops in chain order
+    int ok = 1;                    // All pipes made
+    for (int k = 0; k < branches && ok; k++) {  // Make every pipe before forking anything
+        chain[k][0] = chain[k][1] = feed[k][0] = feed[k][1] = -1;  // Not made yet
+        ok = pipe_open(chain[k], &cfg) == 0 && (k == branches - 1 || pipe_open(feed[k], &cfg) == 0);  // Chain link and branch input
+    }
+    if (!ok) {                     // Out of descriptors
+        perror("pipe failed");     // Report it
+        for (int k = 0; k < branches; k++) for (int e = 0; e < 2; e++) {  // Close whatever was made
+            if (chain[k][e] >= 0) close(chain[k][e]);  // Chain pipe
+            if (feed[k][e] >= 0) close(feed[k][e]);  // Branch pipe
+        }
+        free(chain), free(feed);   // Release the tables
+        job_remove(j);             // Nothing ran
+        return 1;                  // Failure
+    }
+    for (int k = 0; k < branches - 1; k++) {  // One hop per branch but the last
+        fanout_link *l = calloc(1, sizeof(fanout_link));  // New hop
+        l->in_fd = chain[k][0];    // Stream owed to branch k and later
+        l->out_fd = feed[k][1];    // Branch k's input
+        l->next_fd = chain[k + 1][1];  // Rest of the chain
+        *tail = l;                 // Keep chain order
+        tail = &l->next;           // Next one goes after it
+    }
+    int base = 0;                  // First stage index of the current part
+    for (int k = 0; k < n->count; k++) {  // Producer, then each branch
+        node *part = n->items[k];  // This part
+        int linear = part->type == NODE_PIPELINE;  // Pipeline or single command
+        pipe_config part_cfg = pipe_effective(linear ? part->tuning : NULL);  // Its own pipe settings
+        int in = k == 0 ? -1 : k == branches ? chain[k - 1][0] : feed[k - 1][0];  // Producer inherits stdin
+        launch_stages(j, base, linear ? part->items : &n->items[k], linear ? part->count - 1 : 0,
+                      linear && part->reverse, in, k == 0 ? chain[0][1] : -1, &part_cfg);  // Start its stages
+        if (k == 0) close(chain[0][1]);  // Producer owns the chain's head now
+        else close(in);            // Branch owns its input now
+        if (k == n->count - 1) j->sink = base + (linear && part->reverse ? 0 : (linear ? part->count - 1 : 0));  // Last branch decides the status
+        base += linear ? part->count : 1;  // Next part's stages follow
+    }
+    free(chain), free(feed);       // Hops hold the remaining ends
+    pipe_pumps_start();            // Start copying only now: no more forks
+    int status = job_wait(j);      // Wait for every stage
+    job_remove(j);                 // Forget the job
+    fanout_finish();               // Hops end once their readers and the producer are gone
+    if (meter_list) pipe_meters_finish();  // Report any meters inside the parts
+    return status;                 // Status of the last branch
+}
+
+int execute_command(node *cmd) {  // Runs a single command, returns its exit status
+    if (!cmd->argv[0]) return 0;    // If no command, just return
+    return run_pipeline(&cmd, 0, 0, NULL, NULL);  // A one-stage foreground job
+}
+
+int execute_piped_commands(node **commands, int num_pipes, const pipe_config *tuning) {  // Handles piped commands
+    return run_pipeline(commands, num_pipes, 0, NULL, tuning);  // Data flows left to right
+}
+
+int execute_reverse_piped_commands(node **commands, int num_pipes, const pipe_config *tuning) {  // Handles reverse piped commands
+    return run_pipeline(commands, num_pipes, 1, NULL, tuning);  // Data flows right to left
+}
+
+int execute_background(node *n) {  // cmd &: starts a node without waiting for it
+    n->background = 0;          // The node itself runs normally
+    if (n->type == NODE_PIPELINE) return run_pipeline(n->items, n->count - 1, n->reverse, n, n->tuning);  // Stages run directly
+    if (n->type == NODE_COMMAND && !n->memo) return run_pipeline(&n, 0, 0, n, NULL);  // Single program or builtin (memo needs the subshell)
+    fflush(stdout);             // Do not duplicate buffered output
+    long long started = now_ns();  // Spawn latency starts here
+    pid_t pid = fork();         // Anything else needs a subshell
+    if (pid == 0) {             // In the subshell
+        jobs_reset_in_child();  // Do not touch the parent's jobs
+        int status = execute_node(n);  // Run it
+        fflush(stdout);         // Push out its output
+        _exit(status);          // Leave with its status
+    }
+    if (pid < 0) {              // If fork failed
+        perror("fork failed");  // Report the error
+        return 1;               // Nothing started
+    }
+    job *j = job_new(1, 0);     // One-process job
+    job_add_pid(j, 0, pid, started);  // The subshell
+    if (stats_fd >= 0) j->stages[0].label = node_text(n);  // Name it in stats records
+    job_background(j, n);       // Number it
+    return 0;                   // Launching succeeded
+}
+
+void time_report(const char *name, long long us) {  // One line of time's output, e.g. "real\t0m1.250s"
+    fprintf(stderr, "%s\t%lldm%lld.%03llds\n", name, us / 60000000, us / 1000000 % 60, us / 1000 % 1000);  // Minutes and seconds
+}
+
+int execute_timed(node *n) {    // time pipeline: runs it, then reports real, user and sys time on stderr
+    struct rusage self0, kids0, self1, kids1;  // Shell and reaped-children usage before and after
+    long long start = now_ns(); // Wall clock
+    getrusage(RUSAGE_SELF, &self0);  // Builtins run in the shell
+    getrusage(RUSAGE_CHILDREN, &kids0);  // Programs are children
+    n->timed = 0;               // Run it normally
+    int status = execute_node(n);  // Run it
+    n->timed = 1;               // Leave the tree as parsed
+    getrusage(RUSAGE_SELF, &self1);  // Usage after
+    getrusage(RUSAGE_CHILDREN, &kids1);  // Includes every stage it waited for
+    long long user = timeval_us(self1.ru_utime) - timeval_us(self0.ru_utime) + timeval_us(kids1.ru_utime) - timeval_us(kids0.ru_utime);  // User CPU
+    long long sys = timeval_us(self1.ru_stime) - timeval_us(self0.ru_stime) + timeval_us(kids1.ru_stime) - timeval_us(kids0.ru_stime);  // System CPU
+    fflush(stdout);             // Command output first
+    fputc('\n', stderr);        // Blank line like other shells
+    time_report("real", (now_ns() - start) / 1000);  // Elapsed
+    time_report("user", user);  // User CPU
+    time_report("sys", sys);    // System CPU
+    return status;              // Status of the timed pipeline
+}
+
+int execute_sequential_commands(node **commands, int num_commands) {  // Runs commands one after another
+    int status = 0;             // Status of the last command
+    for (int i = 0; i < num_commands; i++) {  // For each command
+        status = execute_node(commands[i]);  // Run the command
+    }
+    return status;              // Last command decides
+}
+
+int execute_conditional_commands(node **commands, int num_commands, char **operators) {  // Handles && and || commands
+    int status = execute_node(commands[0]);  // First command always runs
+    for (int i = 1; i < num_commands; i++) {  // For each following command
+        int is_and = strcmp(operators[i - 1], "&&") == 0;  // Which operator precedes it
+        if ((status == 0) == is_and) status = execute_node(commands[i]);  // && runs after success, || after failure
+    }
+    return status;              // Status of the last command that ran
+}
+
+// Word Counting
+// Words are runs of non-whitespace (space, \t, \n, \v, \f, \r), the same set
+// fscanf("%s") skips. Like the old fscanf("%255s") loop, a run longer than 255
+// bytes counts once per 255-byte piece.
+#define WC_MAX_WORD 255         
+#define WC_BLOCK (1 << 20)      
+#define WC_PARALLEL_MIN (64ULL << 20)  
+#define WC_CHUNK_MIN (16ULL << 20)  
+
+typedef struct {                // Word-count summary of one span of bytes
+    unsigned long long words;   // Word starts inside the span (span start treated as after whitespace)
+    unsigned long long extras;  // Extra 255-byte pieces of runs closed inside the span
+    unsigned long long head;    // Length of the non-whitespace run at the span start
+    unsigned long long carry;   // Length of the run still open at the span end
+    int at_start;               // No whitespace seen yet (whole span is one run)
+} wc_state;
+
+unsigned long long wc_split(unsigned long long run) {  // Extra pieces fscanf("%255s") makes of one run
+    return run ? (run - 1) / WC_MAX_WORD : 0;  // ceil(run / 255) - 1
+}
+
+void wc_block(wc_state *st, uint64_t nonspace, int nbits) {  // Feeds one block (bit i = byte i is not whitespace)
+    uint64_t valid = nbits == 64 ? ~0ULL : ((1ULL << nbits) - 1);  // Bits that are real bytes
+    uint64_t space = ~nonspace & valid;  // Whitespace bytes
+    uint64_t starts = nonspace & ~((nonspace << 1) | (st->carry ? 1 : 0));  // Run starts (bit 0 continues an open run)
+    st->words += __builtin_popcountll(starts);  // Count new words
+    if (!space) {               // Whole block continues the current run
+        st->carry += nbits;     // Run just gets longer
+        return;                 // Nothing closed
+    }
+    unsigned long long closing = st->carry + __builtin_ctzll(space);  // Run that ends at the first space
+    if (st->at_start) {         // First whitespace in the span
+        st->head = closing;     // Leading run may continue the previous span, let the merge decide
+        st->at_start = 0;       // No longer at the start
+    } else {                    // A run fully inside the span
+        st->extras += wc_split(closing);  // Long runs count more than once
+    }
+    st->carry = nbits - 1 - (63 - __builtin_clzll(space));  // Run still open at the block end
+}
+
+uint64_t wc_mask_scalar(const unsigned char *p, int n) {  // Non-whitespace bitmap for up to 64 bytes
+    uint64_t mask = 0;          // Result bits
+    for (int i = 0; i < n; i++) {  // For each byte
+        unsigned char c = p[i]; // Current byte
+        if (c != ' ' && (unsigned char)(c - '\t') > 4) mask |= 1ULL << i;  // Not one of the six spaces
+    }
+    return mask;                // Bitmap
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>          
+
+uint64_t wc_mask_sse2(const unsigned char *p) {  // Non-whitespace bitmap for 64 bytes, 16 at a time
+    const __m128i sp = _mm_set1_epi8(' ');  // Space
+    const __m128i tab = _mm_set1_epi8('\t');  // Start of \t..\r
+    const __m128i four = _mm_set1_epi8(4);  // Width of \t..\r
+    uint64_t mask = 0;          // Result bits
+    for (int i = 0; i < 4; i++) {  // Four 16-byte lanes
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i * 16));  // Load bytes
+        __m128i off = _mm_sub_epi8(v, tab);  // c - '\t'
+        __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(off, four), off);  // (c - '\t') <= 4
+        __m128i ws = _mm_or_si128(ctl, _mm_cmpeq_epi8(v, sp));  // Any whitespace
+        mask |= (uint64_t)(uint16_t)~_mm_movemask_epi8(ws) << (i * 16);  // Keep the non-whitespace bits
+    }
+    return mask;                // Bitmap
+}
+
+__attribute__((target("avx2")))
+uint64_t wc_mask_avx2(const unsigned char *p) {  // Non-whitespace bitmap for 64 bytes, 32 at a time
+    const __m256i sp = _mm256_set1_epi8(' ');  // Space
+    const __m256i tab = _mm256_set1_epi8('\t');  // Start of \t..\r
+    const __m256i four = _mm256_set1_epi8(4);  // Width of \t..\r
+    uint64_t mask = 0;          // Result bits
+    for (int i = 0; i < 2; i++) {  // Two 32-byte lanes
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i * 32));  // Load bytes
+        __m256i off = _mm256_sub_epi8(v, tab);  // c - '\t'
+        __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(off, four), off);  // (c - '\t') <= 4
+        __m256i ws = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, sp));  // Any whitespace
+        mask |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(ws) << (i * 32);  // Keep the non-whitespace bits
+    }
+    return mask;                // Bitmap
+}
+#endif
+
+typedef uint64_t (*wc_mask_fn)(const unsigned char *);  // 64-byte bitmap kernel
+
+wc_mask_fn wc_pick_kernel(void) {  // Chooses the widest kernel this CPU runs
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) return wc_mask_avx2;  // 32 bytes per compare
+    if (__builtin_cpu_supports("sse2")) return wc_mask_sse2;  // 16 bytes per compare
+#endif
+    return NULL;                // Scalar only
+}
+
+void wc_scan(wc_state *st, const unsigned char *p, size_t len) {  // Feeds a buffer into a running count
+    static wc_mask_fn kernel;   // Chosen once
+    static int picked = 0;      // Whether kernel is set
+    if (!picked) { kernel = wc_pick_kernel(); picked = 1; }  // Pick on first use
+    size_t i = 0;               // Current offset
+    for (; i + 64 <= len; i += 64) wc_block(st, kernel ? kernel(p + i) : wc_mask_scalar(p + i, 64), 64);  // Full blocks
+    if (i < len) wc_block(st, wc_mask_scalar(p + i, len - i), len - i);  // Tail bytes
+}
+
+unsigned long long wc_total(const wc_state *spans, int count) {  // Stitches span summaries into one word count
+    unsigned long long total = 0, carry = 0;  // Result and the run open across span boundaries
+    for (int i = 0; i < count; i++) {  // Left to right
+        const wc_state *s = &spans[i];  // This span
+        total += s->words + s->extras;  // Its own words
+        if (carry && (s->at_start ? s->carry : s->head)) total--;  // Its first word continues the previous span's run
+        if (s->at_start) {      // Span had no whitespace at all
+            carry += s->carry;  // Run goes on
+            continue;           // Nothing closed
+        }
+        total += wc_split(carry + s->head);  // Run crossing into this span closes here
+        carry = s->carry;       // Run left open at its end
+    }
+    return total + wc_split(carry);  // Close the final run
+}
+
+typedef struct {                // Work item for one counting thread
+    const unsigned char *data;  // Start of the span
+    size_t len;                 // Span length
+    wc_state state;             // Result
+} wc_job;
+
+void *wc_thread(void *arg) {    // Counts one span of a mapped file
+    wc_job *job = arg;          // Our span
+    wc_scan(&job->state, job->data, job->len);  // Count it
+    return NULL;                // Result is in the job
+}
+
+long long count_words(const char *filename) {  // Word count of a file, -1 on error
+    int fd = open(filename, O_RDONLY);  // Open the file
+    if (fd < 0) {               // If opening failed
+        perror("open failed");  // Report the error
+        return -1;              // Give up
+    }
+    struct stat st;             // File info
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {  // Regular file: map it
+        size_t size = st.st_size;  // Bytes to scan
+        unsigned char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);  // Map the whole file
+        if (data != MAP_FAILED) {  // Mapping worked
+            close(fd);          // Mapping keeps the file alive
+            madvise(data, size, MADV_SEQUENTIAL);  // We read it front to back
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);  // Cores available
+            int threads = 1;    // Spans to count in parallel
+            if (size >= WC_PARALLEL_MIN && cpus > 1) {  // Only worth it for big files
+                threads = cpus < 64 ? cpus : 64;  // One span per core
+                if (size / threads < WC_CHUNK_MIN) threads = size / WC_CHUNK_MIN;  // Keep spans large
+            }
+            wc_job jobs[threads];  // One job per span
+            pthread_t tids[threads];  // Their threads
+            size_t span = size / threads;  // Bytes per span
+            for (int i = 0; i < threads; i++) {  // Lay out the spans
+                jobs[i].data = data + i * span;  // Span start
+                jobs[i].len = i == threads - 1 ? size - i * span : span;  // Last one takes the remainder
+                memset(&jobs[i].state, 0, sizeof(wc_state));  // Fresh summary
+                jobs[i].state.at_start = 1;  // Nothing seen yet
+                if (i == 0 || pthread_create(&tids[i], NULL, wc_thread, &jobs[i]) != 0) {  // Span 0 runs here
+                    wc_thread(&jobs[i]);  // Or if a thread could not start
+                    tids[i] = 0;  // Nothing to join
+                }
+            }
+            wc_state spans[threads];  // Summaries in file order
+            for (int i = 0; i < threads; i++) {  // Collect results
+                if (tids[i]) pthread_join(tids[i], NULL);  // Wait for the thread
+                spans[i] = jobs[i].state;  // Its summary
+            }
+            munmap(data, size); // Release the mapping
+            return wc_total(spans, threads);  // Stitch spans together
+        }
+    }
+
+    unsigned char *buf = malloc(WC_BLOCK);  // Pipes, devices and /proc files: stream in large blocks
+    wc_state state = {0};       // Running summary
+    state.at_start = 1;         // Nothing seen yet
+    ssize_t n;                  // Bytes read
+    while ((n = read(fd, buf, WC_BLOCK)) > 0 || (n < 0 && errno == EINTR)) {  // Read until EOF
+        if (n > 0) wc_scan(&state, buf, n);  // Count this block
+    }
+    if (n < 0) perror("read failed");  // Report a read error
+    free(buf);                  // Release the buffer
+    close(fd);                  // Close the file
+    return n < 0 ? -1 : (long long)wc_total(&state, 1);  // Final count
+}
+
+// File Concatenation
+#define CONCAT_CHUNK (1 << 30)  
+#define CONCAT_BUF (1 << 20)    
+
+int concat_can_fall_back(int err) {  // Whether a kernel copy error just means "try the next method"
+    return err == EXDEV || err == EINVAL || err == ENOSYS || err == EOPNOTSUPP || err == EBADF || err == ESPIPE;  // Unsupported pairing
+}
+
+int concat_fd(int in_fd, int out_fd, const struct stat *in_st, const struct stat *out_st) {  // Copies all of in_fd to out_fd, 0 or -1
+    ssize_t n;                  // Bytes moved per call
+    int kernel_ok = S_ISREG(in_st->st_mode) && in_st->st_size > 0;  // /proc files report size 0 and need real reads
+
+    if (kernel_ok && S_ISREG(out_st->st_mode)) {  // File to file: let the filesystem copy (or reflink) it
+        while ((n = copy_file_range(in_fd, NULL, out_fd, NULL, CONCAT_CHUNK, 0)) > 0 || (n < 0 && errno == EINTR));  // Until EOF
+        if (n == 0) return 0;   // Done
+        if (!concat_can_fall_back(errno)) return -1;  // Real I/O error
+    }
+    if (S_ISFIFO(out_st->st_mode)) {  // Into a pipe: move page references instead of bytes
+        while ((n = splice(in_fd, NULL, out_fd, NULL, CONCAT_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0 || (n < 0 && errno == EINTR));  // Until EOF
+        if (n == 0) return 0;   // Done
+        if (!concat_can_fall_back(errno)) return -1;  // Real I/O error
+    }
+    if (kernel_ok) {            // Anything else: page cache straight to the output
+        while ((n = sendfile(out_fd, in_fd, NULL, CONCAT_CHUNK)) > 0 || (n < 0 && errno == EINTR));  // Until EOF
+        if (n == 0) return 0;   // Done
+        if (!concat_can_fall_back(errno)) return -1;  // Real I/O error
+    }
+
+    char *buf = malloc(CONCAT_BUF);  // Last resort: large buffered copy
+    if (!buf) return -1;        // Out of memory
+    while ((n = read(in_fd, buf, CONCAT_BUF)) != 0) {  // Read until EOF
+        if (n < 0) {            // Read failed
+            if (errno == EINTR) continue;  // Interrupted, try again
+            break;              // Real error
+        }
+        for (ssize_t off = 0; off < n; ) {  // Write it all out
+            ssize_t w = write(out_fd, buf + off, n - off);  // Write what we can
+            if (w < 0 && errno == EINTR) continue;  // Interrupted, try again
+            if (w <= 0) { n = -1; break; }  // Write failed
+            off += w;           // Advance
+        }
+        if (n < 0) break;       // Stop on write failure
+    }
+    free(buf);                  // Release the buffer
+    return n < 0 ? -1 : 0;      // Result
+}
+
+int concat_files(char **args, int argc) {  // file1 + file2 + ...: writes every file to stdout, 0 or 1 if any failed
+    struct stat out_st;         // What stdout is (file, pipe, terminal...)
+    fflush(stdout);             // Anything printf'd so far goes first
+    if (fstat(STDOUT_FILENO, &out_st) < 0) {  // If we cannot tell
+        perror("fstat failed"); // Report the error
+        return 1;               // Stop processing
+    }
+    int status = 0;             // Set once any file fails
+    for (int i = 0; i < argc; i += 2) {  // For each file (skipping +)
+        int fd = open(args[i], O_RDONLY);  // Open the file
+        if (fd < 0) {           // If opening failed
+            perror("open failed");  // Report the error
+            status = 1;         // Remember it
+            continue;           // Skip to next file
+        }
+        struct stat in_st;      // Input file info
+        if (fstat(fd, &in_st) < 0 || concat_fd(fd, STDOUT_FILENO, &in_st, &out_st) < 0) {  // Copy it
+            fprintf(stderr, "%s: %s\n", args[i], strerror(errno));  // Report the error
+            status = 1;         // Remember it
+        }
+        close(fd);              // Close the file
+    }
+    return status;              // 0 only if every file was copied
+}
+
+// File Swapping
+int swap_copy_beside(const char *src, const char *dest, char *tmp, size_t tmp_len) {  // Copies src into a temp file in dest's directory, 0 or -1
+    const char *slash = strrchr(dest, '/');  // Directory part of dest
+    if (slash) snprintf(tmp, tmp_len, "%.*s/.w25swap.XXXXXX", (int)(slash - dest), dest);  // Same directory, same filesystem
+    else snprintf(tmp, tmp_len, ".w25swap.XXXXXX");  // dest is in the current directory
+    int out_fd = mkstemp(tmp);  // Create the temp file
+    if (out_fd < 0) return -1;  // Could not create it
+    int in_fd = open(src, O_RDONLY);  // Open the source
+    struct stat in_st, out_st, dest_st;  // File info
+    int ok = in_fd >= 0 && fstat(in_fd, &in_st) == 0 && fstat(out_fd, &out_st) == 0 &&
+             concat_fd(in_fd, out_fd, &in_st, &out_st) == 0;  // Stream the contents, constant memory
+    if (ok && stat(dest, &dest_st) == 0) fchmod(out_fd, dest_st.st_mode & 07777);  // Keep dest's permissions
+    int saved = errno;          // Keep the copy error for the caller
+    if (in_fd >= 0) close(in_fd);  // Close the source
+    close(out_fd);              // Close the temp file
+    if (!ok) unlink(tmp);       // Do not leave a partial copy behind
+    errno = saved;              // Restore the error
+    return ok ? 0 : -1;         // Result
+}
+
+int swap_files(const char *file1, const char *file2) {  // file1 ~ file2: exchanges the two files' contents, 0 or 1
+    if (renameat2(AT_FDCWD, file1, AT_FDCWD, file2, RENAME_EXCHANGE) == 0) return 0;  // Same filesystem: one atomic O(1) syscall
+    if (errno != EXDEV && errno != EINVAL && errno != ENOSYS) {  // A real error (missing file, permissions...)
+        perror("~ failed");     // Report the error
+        return 1;               // Stop processing
+    }
+
+    char tmp1[PATH_MAX], tmp2[PATH_MAX];  // Across filesystems: stream each file into a temp beside the other
+    if (swap_copy_beside(file2, file1, tmp1, sizeof(tmp1)) < 0) {  // file2's contents, next to file1
+        perror("~ failed");     // Report the error
+        return 1;               // Nothing changed yet
+    }
+    if (swap_copy_beside(file1, file2, tmp2, sizeof(tmp2)) < 0) {  // file1's contents, next to file2
+        perror("~ failed");     // Report the error
+        unlink(tmp1);           // Drop the first copy
+        return 1;               // Nothing changed yet
+    }
+    char backup[PATH_MAX + 8];  // Second name for file1's original, so the swap can be undone
+    snprintf(backup, sizeof(backup), "%s.orig", tmp1);  // Unique because tmp1 is
+    int have_backup = link(file1, backup) == 0;  // Keeps the original inode alive past the first rename
+    if (rename(tmp1, file1) < 0) {  // Atomically replace file1
+        perror("~ failed");     // Report the error
+        unlink(tmp1);           // Drop both copies
+        unlink(tmp2);           // Nothing changed
+        if (have_backup) unlink(backup);  // Not needed
+        return 1;               // Failed
+    }
+    if (rename(tmp2, file2) < 0) {  // Atomically replace file2
+        int err = errno;        // Why
+        if (have_backup && rename(backup, file1) == 0) {  // Put file1's original back
+            unlink(tmp2);       // The copy is no longer the only one
+            fprintf(stderr, "~ failed: %s (nothing was changed)\n", strerror(err));  // Rolled back
+        } else {                // No way back: never delete the only copy of file1's original
+            fprintf(stderr, "~ failed: %s; the original contents of %s are in %s\n", strerror(err), file1, tmp2);  // Tell the user where
+            if (have_backup) unlink(backup);  // Only a name for the old inode, tmp2 is the copy
+        }
+        return 1;               // Failed
+    }
+    if (have_backup) unlink(backup);  // Swapped: drop the extra name
+    return 0;                   // Swapped
+}
+
+// File Operations
+int execute_file_operations(char **args) {  // Handles special file operations, returns 0 or 1 on failure
+    int argc = 0;            // Counter for arguments
+    while (args[argc]) argc++;  // Count arguments
+
+    if (strcmp(args[0], "#") == 0) {  // If we're counting words
+        if (argc != 2) {     // Check if we have exactly one filename
+            fprintf(stderr, "# requires exactly 1 file argument\n");  // Complain if not
+            return 1;        // Stop processing
+        }
+        long long word_count = count_words(args[1]);  // Count words in the file
+        if (word_count < 0) return 1;  // count_words reported the error
+        printf("%lld\n", word_count);  // Print the word count
+    } else if (argc >= 3 && strcmp(args[1], "~") == 0) {  // If we're swapping file contents
+        if (argc != 3) {     // Check if we have exactly two filenames
+            fprintf(stderr, "~ requires exactly 2 file arguments\n");  // Complain if not
+            return 1;        // Stop processing
+        }
+        return swap_files(args[0], args[2]);  // Exchange the files' contents
+    } else if (argc >= 3 && strcmp(args[1], "+") == 0) {  // If we're concatenating files
+        return concat_files(args, argc);  // Copy each file to stdout inside the kernel
+    }
+    return 0;                // Done
+}
+
+// Parallel Execution
+// parallel [-j N] [-k] 'cmd1' 'cmd2' ...: runs each argument as a command line
+// with at most N in flight (default: online CPUs), starting the next as soon
+// as one finishes. Each task's stdout/stderr go to its own memfd and are copied
+// out in one piece when it finishes (or in argument order with -k), so output
+// never interleaves.
+typedef struct {                // One command line given to parallel
+    const char *text;           // Command line
+    job *job;                   // Its subshell, while running
+    int out_fd;                 // memfd holding its stdout
+    int err_fd;                 // memfd holding its stderr
+    int status;                 // Exit status once finished
+    int state;                  // 0 = waiting, 1 = running, 2 = finished, 3 = output written
+} parallel_task;
+
+void parallel_replay(int fd, int target) {  // Copies a captured memfd to stdout/stderr in one go
+    struct stat in_st, out_st;  // Source and destination info
+    if (lseek(fd, 0, SEEK_SET) == 0 && fstat(fd, &in_st) == 0 && in_st.st_size > 0 && fstat(target, &out_st) == 0) {  // Anything captured
+        concat_fd(fd, target, &in_st, &out_st);  // sendfile/splice/copy_file_range as the target allows
+    }
+    close(fd);                  // Done with the capture
+}
+
+int parallel_start(parallel_task *t) {  // Forks a subshell for one task, 0 or -1
+    t->out_fd = memfd_create("w25-parallel-out", MFD_CLOEXEC);  // Capture for stdout
+    t->err_fd = memfd_create("w25-parallel-err", MFD_CLOEXEC);  // Capture for stderr
+    if (t->out_fd < 0 || t->err_fd < 0) {  // No memfds
+        perror("memfd_create failed");  // Report the error
+        return -1;              // Task cannot run
+    }
+    fflush(stdout);             // Do not duplicate buffered output
+    long long started = now_ns();  // Spawn latency starts here
+    pid_t pid = fork();         // Subshell for the task
+    if (pid == 0) {             // In the subshell
+        jobs_reset_in_child();  // Do not touch the parent's jobs
+        dup2(t->out_fd, STDOUT_FILENO);  // stdout goes to the capture
+        dup2(t->err_fd, STDERR_FILENO);  // stderr too
+        arena task_arena = {0}; // Task's own parse arena
+        const char *error = NULL;  // Syntax error, if any
+        node *tree = parse_line(&task_arena, t->text, &error);  // Parse the command line
+        int status = 0;         // Task status
+        if (error) fprintf(stderr, "w25shell: %s\n", error), status = 2;  // Bad syntax
+        else if (tree) status = execute_node(tree);  // Run it
+        fflush(stdout);         // Push its output into the capture
+        _exit(status);          // Leave with its status
+    }
+    if (pid < 0) {              // If fork failed
+        perror("fork failed");  // Report the error
+        return -1;              // Task cannot run
+    }
+    t->job = job_new(1, 0);     // Track the subshell like any other job
+    job_add_pid(t->job, 0, pid, started);  // Its PID
+    if (stats_fd >= 0) t->job->stages[0].label = strdup(t->text);  // Name it in stats records
+    t->state = 1;               // Running
+    return 0;                   // Started
+}
+
+int parallel_builtin(char **args) {  // parallel [-j N] [-k] cmd...
+    long max = sysconf(_SC_NPROCESSORS_ONLN);  // Default: one task per online CPU
+    int keep_order = 0;         // -k: write output in argument order
+    int i = 1;                  // First non-option argument
+    for (; args[i] && args[i][0] == '-'; i++) {  // Options
+        if (strcmp(args[i], "-k") == 0) keep_order = 1;  // Keep order
+        else if (strcmp(args[i], "-j") == 0 && args[i + 1]) max = atol(args[++i]);  // Concurrency limit
+        else if (strncmp(args[i], "-j", 2) == 0 && args[i][2]) max = atol(args[i] + 2);  // -jN
+        else { fprintf(stderr, "parallel: usage: parallel [-j N] [-k] command...\n"); return 2; }  // Unknown option
+    }
+    if (max < 1) max = 1;       // At least one at a time
+    int count = 0;              // Number of tasks
+    while (args[i + count]) count++;  // Count them
+    parallel_task *tasks = calloc(count ? count : 1, sizeof(parallel_task));  // Task table
+    for (int t = 0; t < count; t++) tasks[t].text = args[i + t];  // Command lines
+
+    int next = 0, running = 0, written = 0, failed = 0;  // Scheduler state
+    while (written < count) {   // Until every task's output is out
+        while (running < max && next < count) {  // Fill free slots
+            parallel_task *t = &tasks[next++];  // Next task
+            if (parallel_start(t) == 0) running++;  // Started
+            else t->state = 2, t->status = 127;  // Could not start
+        }
+        if (running) event_loop(NULL, -1);  // Sleep until some child exits
+        for (int t = 0; t < count; t++) {  // Collect finished tasks
+            if (tasks[t].state != 1 || tasks[t].job->remaining) continue;  // Still running (or not started)
+            tasks[t].status = job_status(tasks[t].job);  // Its exit status
+            job_remove(tasks[t].job);  // Forget the job
+            tasks[t].state = 2; // Finished
+            running--;          // Slot is free again
+        }
+        for (int t = keep_order ? written : 0; t < count; t++) {  // Write out finished tasks
+            if (tasks[t].state == 3) continue;  // Already written
+            if (tasks[t].state != 2) { if (keep_order) break; continue; }  // -k waits for earlier tasks
+            fflush(stdout);     // Shell output first
+            if (tasks[t].out_fd > 0) parallel_replay(tasks[t].out_fd, STDOUT_FILENO);  // Its stdout
+            if (tasks[t].err_fd > 0) parallel_replay(tasks[t].err_fd, STDERR_FILENO);  // Its stderr
+            if (tasks[t].status) failed++;  // Count failures
+            tasks[t].state = 3; // Written
+            written++;          // One more done
+        }
+    }
+    free(tasks);                // Release the table
+    return failed > 100 ? 101 : failed;  // Number of failed tasks, like GNU parallel
+}
+
+// Command History
+// History is one append-only file (~/.w25shell_history, or $W25SHELL_HISTFILE)
+// with one command per line. Every shell appends with a single O_APPEND write,
+// so lines from concurrent shells never interleave. The file is only mapped and
+// indexed the first time history is used, and after that only the bytes other
+// shells (or we) appended since are indexed. The index is a trigram signature
+// per block of HIST_BLOCK entries: a search skips every block whose signature
+// lacks one of the query's trigrams and runs memmem only inside the rest.
+// Entries are indexed as "\n" + text, so a prefix search is a substring search
+// for "\n" + prefix.
+#define HIST_BLOCK 64           // Entries per signature block
+#define HIST_SIG_BITS 8192      // Bits in a block's trigram signature
+#define HIST_SIG_WORDS (HIST_SIG_BITS / 64)  // 64-bit words per signature
+
+typedef struct {                // The history file and its index
+    int fd;                     // History file opened O_APPEND (a memfd when there is no file), -1 before history_open
+    char *map;                  // Shared read-only mapping of the file
+    size_t mapped;              // Bytes mapped
+    size_t indexed;             // Bytes indexed (always ends after a newline)
+    size_t *lines;              // File offset of each entry
+    int count;                  // Entries indexed
+    int cap;                    // Room in lines
+    uint64_t *sigs;             // HIST_SIG_WORDS per block of entries
+    int loaded;                 // Mapped and indexed at least once
+    char *last;                 // Last line this shell added (consecutive duplicates are skipped)
+} history;
+
+history hist = {-1};            // The shell's history
+
+void history_open(void) {       // Opens the history file; called once for interactive shells
+    const char *path = getenv("W25SHELL_HISTFILE");  // Explicit file ("" = keep history in memory only)
+    char home_path[PATH_MAX];   // ~/.w25shell_history
+    if (!path && getenv("HOME")) {  // Default location
+        snprintf(home_path, sizeof(home_path), "%s/.w25shell_history", getenv("HOME"));  // Build it
+        path = home_path;       // Use it
+    }
+    if (path && *path) hist.fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);  // Private to the user
+    if (hist.fd < 0) hist.fd = memfd_create("w25-history", MFD_CLOEXEC);  // No file: same code, nothing persists
+}
+
+char *history_entry(int i, size_t *len) {  // Text of entry i (not NUL-terminated) and its length
+    size_t end = (i + 1 < hist.count ? hist.lines[i + 1] : hist.indexed) - 1;  // Its newline
+    *len = end - hist.lines[i]; // Without the newline
+    return hist.map + hist.lines[i];  // Inside the mapping
+}
+
+unsigned history_trigram(const char *p) {  // Signature bit for the three bytes at p
+    unsigned t = (unsigned char)p[0] << 16 | (unsigned char)p[1] << 8 | (unsigned char)p[2];  // The trigram
+    return (t * 2654435761u) >> (32 - 13);  // Multiplicative hash down to 13 bits (HIST_SIG_BITS)
+}
+
+void history_index_entry(int i) {  // Adds entry i to its block's signature
+    size_t len;                 // Entry length
+    char *text = history_entry(i, &len) - 1;  // Starts at the previous newline (or a virtual one at the file start)
+    uint64_t *sig = hist.sigs + (size_t)(i / HIST_BLOCK) * HIST_SIG_WORDS;  // Its block
+    char first[3] = {'\n', len > 0 ? text[1] : '\n', len > 1 ? text[2] : '\n'};  // Anchored first trigram
+    unsigned bit = history_trigram(first);  // Entry 0 has no newline before it, so build this one by hand
+    sig[bit / 64] |= 1ULL << (bit % 64);  // Set it
+    for (size_t k = 1; k + 2 <= len; k++) {  // Remaining trigrams
+        bit = history_trigram(text + k);  // Hash it
+        sig[bit / 64] |= 1ULL << (bit % 64);  // Set it
+    }
+}
+
+void history_sync(void) {       // Maps and indexes whatever was appended since the last call
+    struct stat st;             // Current file size
+    if (hist.fd < 0 || fstat(hist.fd, &st) < 0) return;  // No history
+    size_t size = st.st_size;   // Bytes in the file now
+    hist.loaded = 1;            // From now on the index is kept current
+    if (size < hist.indexed) {  // Truncated by someone: start over
+        if (hist.map) munmap(hist.map, hist.mapped);  // Drop the old mapping
+        hist.map = NULL, hist.mapped = hist.indexed = 0, hist.count = 0;  // Empty index
+        free(hist.sigs), hist.sigs = NULL;  // And no signatures
+    }
+    if (size == hist.mapped) return;  // Nothing new
+    char *map = hist.map ? mremap(hist.map, hist.mapped, size, MREMAP_MAYMOVE)  // Grow the mapping
+                         : mmap(NULL, size, PROT_READ, MAP_SHARED, hist.fd, 0);  // Or make the first one
+    if (map == MAP_FAILED) return;  // Keep what we have
+    hist.map = map, hist.mapped = size;  // New mapping
+    int old_blocks = (hist.count + HIST_BLOCK - 1) / HIST_BLOCK;  // Signatures that exist
+    int first = hist.count;     // First entry to index
+    for (char *p = map + hist.indexed, *end = map + size, *nl; (nl = memchr(p, '\n', end - p)); p = nl + 1) {  // Each complete new line
+        if (hist.count == hist.cap) {  // Out of room
+            hist.cap = hist.cap ? hist.cap * 2 : 4096;  // Grow geometrically
+            hist.lines = realloc(hist.lines, hist.cap * sizeof(size_t));  // Resize
+        }
+        hist.lines[hist.count++] = p - map;  // Entry starts here
+        hist.indexed = nl + 1 - map;  // Indexed through its newline
+    }
+    int blocks = (hist.count + HIST_BLOCK - 1) / HIST_BLOCK;  // Signatures needed now
+    if (blocks > old_blocks) {  // New blocks start empty
+        hist.sigs = realloc(hist.sigs, (size_t)blocks * HIST_SIG_WORDS * sizeof(uint64_t));  // Room for them
+        memset(hist.sigs + (size_t)old_blocks * HIST_SIG_WORDS, 0, (size_t)(blocks - old_blocks) * HIST_SIG_WORDS * sizeof(uint64_t));  // Clear them
+    }
+    for (int i = first; i < hist.count; i++) history_index_entry(i);  // Sign the new entries
+}
+
+void history_add(const char *line) {  // Appends a command line to the history file
+    if (hist.fd < 0) return;    // History is off (batch mode)
+    const char *p = line;       // Skip leading blanks
+    while (*p == ' ' || *p == '\t') p++;  // To check for an empty line
+    if (!*p || (hist.last && strcmp(hist.last, line) == 0)) return;  // Blank or the same as last time
+    free(hist.last);            // Forget the previous one
+    hist.last = strdup(line);   // Remember this one
+    struct iovec iov[2] = {{(void *)line, strlen(line)}, {"\n", 1}};  // Text and newline
+    if (writev(hist.fd, iov, 2) < 0) return;  // One O_APPEND write: atomic against other shells
+    if (hist.loaded) history_sync();  // Keep a loaded index current
+}
+
+int history_search(const char *query, size_t qlen, int prefix, int before) {  // Newest entry below before containing (or starting with) query, -1 if none
+    if (!hist.loaded) history_sync();  // First use maps the file
+    if (before > hist.count) before = hist.count;  // Clamp
+    char anchored[qlen + 1];    // "\n" + query for prefix searches
+    anchored[0] = '\n';         // Entries are indexed as if preceded by a newline
+    memcpy(anchored + 1, query, qlen);  // Then the query
+    const char *pattern = prefix ? anchored : query;  // What to hash
+    size_t plen = qlen + prefix;  // Its length
+    unsigned bits[64];          // Trigram bits to require (more are not needed to be selective)
+    int nbits = 0;              // How many
+    for (size_t k = 0; k + 3 <= plen && nbits < 64; k++) bits[nbits++] = history_trigram(pattern + k);  // Hash them
+    for (int i = before - 1; i >= 0; ) {  // Newest first
+        uint64_t *sig = hist.sigs + (size_t)(i / HIST_BLOCK) * HIST_SIG_WORDS;  // Entry i's block
+        int candidate = 1;      // Block may hold a match
+        for (int b = 0; b < nbits && candidate; b++) candidate = (sig[bits[b] / 64] >> (bits[b] % 64)) & 1;  // Every trigram present?
+        int block_start = i - i % HIST_BLOCK;  // First entry of the block
+        if (!candidate) { i = block_start - 1; continue; }  // Skip the whole block
+        for (; i >= block_start; i--) {  // Check each entry
+            size_t len;         // Entry length
+            char *text = history_entry(i, &len);  // Entry text
+            if (prefix ? len >= qlen && memcmp(text, query, qlen) == 0 : memmem(text, len, query, qlen) != NULL) return i;  // Found
+        }
+    }
+    return -1;                  // No match
+}
+
+char *history_expand(char *line) {  // Expands !! and !prefix at the start of words; NULL if an event is not found
+    if (!strchr(line, '!')) return line;  // Nothing to do (the common case)
+    char *out;                  // Expanded line
+    size_t size;                // Its length
+    FILE *fp = open_memstream(&out, &size);  // Built as we go
+    int changed = 0, squote = 0;  // Something expanded, inside '...'
+    for (char *p = line; *p; p++) {  // Each character
+        if (*p == '\'') squote = !squote;  // Single quotes keep ! literal
+        int word_start = p == line || strchr(" \t;|&<>(", p[-1]);  // ! only counts at the start of a word
+        size_t n = *p == '!' && !squote && word_start ? strcspn(p + 1, " \t;|&<>()=\"'") : 0;  // Length of the event name
+        if (!n) { fputc(*p, fp); continue; }  // Ordinary character (or a lone !)
+        int last = p[1] == '!';  // !! is the previous command
+        int i = history_search(p + 1, last ? 0 : n, 1, INT_MAX);  // Newest entry starting with the name
+        if (i < 0) {            // No such event
+            fprintf(stderr, "w25shell: %.*s: event not found\n", (int)(last ? 2 : n + 1), p);  // Like bash
+            fclose(fp), free(out);  // Drop the partial line
+            return NULL;        // Do not run anything
+        }
+        size_t len;             // Entry length
+        char *text = history_entry(i, &len);  // Entry text
+        fwrite(text, 1, len, fp);  // Substitute it
+        p += last ? 1 : n;      // Skip the event name
+        changed = 1;            // Show the result
+    }
+    fclose(fp);                 // Finish the text
+    if (!changed) { free(out); return line; }  // Only literal !s
+    printf("%s\n", out);        // Show what will run, like bash
+    return out;                 // Caller frees it
+}
+
+int history_builtin(char **args, int argc) {  // history [N]: lists the last N entries (all by default)
+    if (hist.fd < 0) return 0;  // No history in batch mode
+    history_sync();             // Pick up other shells' commands too
+    int n = argc > 1 ? atoi(args[1]) : hist.count;  // How many
+    if (n < 0 || n > hist.count) n = hist.count;  // Clamp
+    for (int i = hist.count - n; i < hist.count; i++) {  // Oldest first
+        size_t len;             // Entry length
+        char *text = history_entry(i, &len);  // Entry text
+        printf("%5d  %.*s\n", i + 1, (int)len, text);  // Numbered like bash
+    }
+    return 0;                   // Success
+}
+
+// Builtin Commands
+// Builtins run inside the shell, so cd and export change the shell itself and
+// echo, test and friends cost no fork or exec. They are found with a perfect
+// hash over the name's length, first and last byte: every builtin has its own
+// slot in builtin_table, so a lookup is one hash and at most one strcmp.
+typedef int (*builtin_fn)(char **args, int argc);  // Runs a builtin, returns its exit status
+
+#define BUILTIN_SLOTS 32        // Power of two above the number of builtins
+#define BUILTIN_HASH(len, first, last) (((len) + (first) * 28 + (last)) & (BUILTIN_SLOTS - 1))  // Collision-free for the names below
+#define BUILTIN_ENTRY(name, first, last, fn) [BUILTIN_HASH(sizeof(name) - 1, first, last)] = {name, fn}  // Slot computed, not hand-written
+
+int cd_builtin(char **args, int argc) {  // cd [dir|-]: changes the shell's own directory
+    const char *dir = argc > 1 ? args[1] : getenv("HOME");  // Default is $HOME
+    int show = 0;               // cd - prints where it went
+    if (dir && strcmp(dir, "-") == 0) {  // Back to the previous directory
+        dir = getenv("OLDPWD"); // Where we were
+        show = 1;               // Tell the user
+        if (!dir) { fprintf(stderr, "cd: OLDPWD not set\n"); return 1; }  // Nowhere to go
+    }
+    if (!dir) { fprintf(stderr, "cd: HOME not set\n"); return 1; }  // Nowhere to go
+    char old[PATH_MAX];         // Directory we are leaving
+    int have_old = getcwd(old, sizeof(old)) != NULL;  // It may have been removed
+    if (chdir(dir) < 0) {       // Try to move
+        fprintf(stderr, "cd: %s: %s\n", dir, strerror(errno));  // Report the error
+        return 1;               // Failure
+    }
+    char cwd[PATH_MAX];         // Directory we arrived in
+    if (have_old) setenv("OLDPWD", old, 1);  // Remember for cd -
+    if (getcwd(cwd, sizeof(cwd))) {  // Resolve the new directory
+        setenv("PWD", cwd, 1);  // Keep $PWD in step
+        if (show) printf("%s\n", cwd);  // cd - shows the destination
+    }
+    return 0;                   // Success
+}
+
+int echo_builtin(char **args, int argc) {  // echo [-n] words...
+    int i = 1, newline = 1;     // First word, trailing newline
+    if (argc > 1 && strcmp(args[1], "-n") == 0) newline = 0, i = 2;  // -n drops the newline
+    for (; i < argc; i++) {     // Each word
+        fputs(args[i], stdout); // Print it
+        if (i + 1 < argc) putchar(' ');  // Separated by spaces
+    }
+    if (newline) putchar('\n'); // End the line
+    return ferror(stdout) ? 1 : 0;  // Failed writes fail the command
+}
+
+int pwd_builtin(char **args, int argc) {  // pwd: prints the current directory
+    char cwd[PATH_MAX];         // Current directory
+    if (!getcwd(cwd, sizeof(cwd))) { perror("pwd"); return 1; }  // Removed from under us
+    printf("%s\n", cwd);        // Print it
+    return 0;                   // Success
+}
+
+int true_builtin(char **args, int argc) { return 0; }   // true: always succeeds
+int false_builtin(char **args, int argc) { return 1; }  // false: always fails
+
+int test_unary(const char *op, const char *arg) {  // -e file, -z str, ...: 1 true, 0 false, -1 unknown
+    struct stat st;             // File details
+    if (strcmp(op, "-z") == 0) return arg[0] == '\0';  // Empty string
+    if (strcmp(op, "-n") == 0) return arg[0] != '\0';  // Non-empty string
+    if (strcmp(op, "-r") == 0) return access(arg, R_OK) == 0;  // Readable
+    if (strcmp(op, "-w") == 0) return access(arg, W_OK) == 0;  // Writable
+    if (strcmp(op, "-x") == 0) return access(arg, X_OK) == 0;  // Executable
+    if (strchr("efdsL", op[1]) == NULL || op[0] != '-' || op[2]) return -1;  // Not a file test
+    if ((op[1] == 'L' ? lstat(arg, &st) : stat(arg, &st)) < 0) return 0;  // Missing file fails every file test
+    switch (op[1]) {            // Which property
+        case 'e': return 1;     // Exists
+        case 'f': return S_ISREG(st.st_mode);  // Regular file
+        case 'd': return S_ISDIR(st.st_mode);  // Directory
+        case 's': return st.st_size > 0;  // Non-empty
+        case 'L': return S_ISLNK(st.st_mode);  // Symbolic link
+    }
+    return -1;                  // Unreachable
+}
+
+int test_binary(const char *a, const char *op, const char *b) {  // a = b, a -lt b, ...: 1 true, 0 false, -1 unknown
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) return strcmp(a, b) == 0;  // Same string
+    if (strcmp(op, "!=") == 0) return strcmp(a, b) != 0;  // Different string
+    const char *ops[] = {"-eq", "-ne", "-lt", "-le", "-gt", "-ge"};  // Integer comparisons
+    for (int i = 0; i < 6; i++) {  // Find the operator
+        if (strcmp(op, ops[i]) != 0) continue;  // Not this one
+        char *end_a, *end_b;    // Where the numbers stop
+        long long x = strtoll(a, &end_a, 10), y = strtoll(b, &end_b, 10);  // Both sides
+        if (!*a || *end_a || !*b || *end_b) return -1;  // Not integers
+        int r[] = {x == y, x != y, x < y, x <= y, x > y, x >= y};  // Every comparison
+        return r[i];            // The one asked for
+    }
+    return -1;                  // Unknown operator
+}
+
+int test_builtin(char **args, int argc) {  // test expr / [ expr ]: 0 true, 1 false, 2 error
+    if (strcmp(args[0], "[") == 0) {  // Bracket form needs its ]
+        if (strcmp(args[argc - 1], "]") != 0) { fprintf(stderr, "[: missing `]'\n"); return 2; }  // Unclosed
+        argc--;                 // Ignore the ]
+    }
+    char **a = args + 1;        // The expression
+    int n = argc - 1;           // Its length
+    int negate = 0;             // Leading !
+    if (n > 1 && strcmp(a[0], "!") == 0) negate = 1, a++, n--;  // ! expr
+    int r;                      // 1 true, 0 false, -1 error
+    if (n == 0) r = 0;          // No expression is false
+    else if (n == 1) r = a[0][0] != '\0';  // A lone string is true when non-empty
+    else if (n == 2) r = test_unary(a[0], a[1]);  // -op arg
+    else if (n == 3) r = test_binary(a[0], a[1], a[2]);  // arg op arg
+    else r = -1;                // Longer expressions are not supported
+    if (r < 0) { fprintf(stderr, "%s: bad expression\n", args[0]); return 2; }  // Report the error
+    return (r ^ negate) ? 0 : 1;  // Exit status of the test
+}
+
+int export_builtin(char **args, int argc) {  // export [NAME=VALUE|NAME]...
+    if (argc == 1) {            // No arguments: list the environment
+        for (char **e = environ; *e; e++) {  // Each variable
+            char *eq = strchr(*e, '=');  // Split name and value
+            if (eq) printf("export %.*s=\"%s\"\n", (int)(eq - *e), *e, eq + 1);  // Print it re-readably
+        }
+        return 0;               // Done
+    }
+    int status = 0;             // Any bad names
+    for (int i = 1; i < argc; i++) {  // Each assignment
+        char *eq = strchr(args[i], '=');  // NAME=VALUE?
+        size_t len = eq ? (size_t)(eq - args[i]) : strlen(args[i]);  // Length of the name
+        int valid = len > 0 && !isdigit((unsigned char)args[i][0]);  // Names cannot start with a digit
+        for (size_t k = 0; valid && k < len; k++) valid = isalnum((unsigned char)args[i][k]) || args[i][k] == '_';  // Letters, digits, _
+        if (!valid) { fprintf(stderr, "export: `%s': not a valid identifier\n", args[i]); status = 1; continue; }  // Skip it
+        if (!eq) continue;      // Plain NAME: everything is already exported
+        *eq = '\0';             // Split in place (the word lives in the line arena)
+        setenv(args[i], eq + 1, 1);  // Set it for us and every child
+        *eq = '=';              // Put the word back
+    }
+    return status;              // 0 unless a name was bad
+}
+
+int killterm_builtin(char **args, int argc) { killterm(); return 0; }  // killterm
+int killallterms_builtin(char **args, int argc) { killallterms(); return 0; }  // killallterms
+int hash_table_builtin(char **args, int argc) { hash_builtin(args); return 0; }  // hash [-r]
+int jobs_table_builtin(char **args, int argc) { return jobs_builtin(args); }  // jobs
+int wait_table_builtin(char **args, int argc) { return wait_builtin(args); }  // wait [%N|pid]
+int fg_table_builtin(char **args, int argc) { return fg_builtin(args); }  // fg [%N|pid]
+int set_table_builtin(char **args, int argc) { return set_builtin(args); }  // set -o|+o pipefail
+int parallel_table_builtin(char **args, int argc) { return parallel_builtin(args); }  // parallel [-j N] [-k] cmds...
+
+typedef struct builtin {        // One slot of the builtin table
+    const char *name;           // Command name (NULL = empty slot)
+    builtin_fn run;             // Implementation
+} builtin;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Woverride-init"  // Two builtins in one slot is a compile error
+const builtin builtin_table[BUILTIN_SLOTS] = {  // Each entry lands in the slot BUILTIN_HASH gives its name
+    BUILTIN_ENTRY("cd", 'c', 'd', cd_builtin),
+    BUILTIN_ENTRY("echo", 'e', 'o', echo_builtin),
+    BUILTIN_ENTRY("pwd", 'p', 'd', pwd_builtin),
+    BUILTIN_ENTRY("true", 't', 'e', true_builtin),
+    BUILTIN_ENTRY("false", 'f', 'e', false_builtin),
+    BUILTIN_ENTRY("test", 't', 't', test_builtin),
+    BUILTIN_ENTRY("[", '[', '[', test_builtin),
+    BUILTIN_ENTRY("export", 'e', 't', export_builtin),
+    BUILTIN_ENTRY("killterm", 'k', 'm', killterm_builtin),
+    BUILTIN_ENTRY("killallterms", 'k', 's', killallterms_builtin),
+    BUILTIN_ENTRY("hash", 'h', 'h', hash_table_builtin),
+    BUILTIN_ENTRY("jobs", 'j', 's', jobs_table_builtin),
+    BUILTIN_ENTRY("wait", 'w', 't', wait_table_builtin),
+    BUILTIN_ENTRY("fg", 'f', 'g', fg_table_builtin),
+    BUILTIN_ENTRY("set", 's', 't', set_table_builtin),
+    BUILTIN_ENTRY("parallel", 'p', 'l', parallel_table_builtin),
+    BUILTIN_ENTRY("history", 'h', 'y', history_builtin),
+};
+#pragma GCC diagnostic pop
+
+void builtin_table_check(void) {  // Fails loudly if an entry's first/last byte does not match its name
+    for (int i = 0; i < BUILTIN_SLOTS; i++) {  // Every slot
+        const char *name = builtin_table[i].name;  // Entry there, if any
+        size_t len = name ? strlen(name) : 0;  // Its length
+        if (name && BUILTIN_HASH(len, (unsigned char)name[0], (unsigned char)name[len - 1]) != i) {  // builtin_find would never reach it
+            fprintf(stderr, "w25shell: builtin table: \"%s\" is in slot %d but hashes elsewhere\n", name, i);  // Name the culprit
+            abort();            // A broken build, not a runtime condition
+        }
+    }
+}
+
+builtin_fn builtin_find(const char *name) {  // Looks a command name up, NULL if it is not a builtin
+    size_t len = strlen(name);  // Name length
+    if (len == 0) return NULL;  // Empty word
+    const builtin *b = &builtin_table[BUILTIN_HASH(len, (unsigned char)name[0], (unsigned char)name[len - 1])];  // Its only possible slot
+    return b->name && strcmp(b->name, name) == 0 ? b->run : NULL;  // Same name?
+}
+
+int is_file_operation(char **args) {  // # file, a ~ b, a + b + ...
+    return strcmp(args[0], "#") == 0 || (args[1] && (strcmp(args[1], "~") == 0 || strcmp(args[1], "+") == 0));  // Recognised by shape, not name
+}
+
+int is_shell_command(node *cmd) {  // Whether a command node runs inside the shell rather than as a program
+    char **args = cmd->argv;    // Its words
+    return !args[0] || is_file_operation(args) || builtin_find(args[0]) != NULL;  // Redirection-only, file operation or builtin
+}
+
+int run_shell_command(node *cmd) {  // Runs a shell-side command in this process, redirections already applied
+    char **args = cmd->argv;    // Its words
+    if (!args[0]) return 0;     // Redirection only: opening the files was the whole job
+    if (is_file_operation(args)) {  // File operation?
+        return execute_file_operations(args);  // Handle file operation (it reports its own errors)
+    }
+    return builtin_find(args[0])(args, cmd->count);  // Table dispatch
+}
+
+void stats_builtin(node *cmd, int status, long long started, struct rusage *before) {  // Stats record for an in-process command
+    job_stage st = {.pid = getpid(), .status = status, .start_ns = started, .end_ns = now_ns()};  // The shell itself ran it
+    getrusage(RUSAGE_SELF, &st.usage);  // Resources used so far
+    timersub(&st.usage.ru_utime, &before->ru_utime, &st.usage.ru_utime);  // CPU spent on this command only
+    timersub(&st.usage.ru_stime, &before->ru_stime, &st.usage.ru_stime);  // Same for system time
+    st.usage.ru_nvcsw -= before->ru_nvcsw;  // And context switches (max RSS stays the shell's peak)
+    st.usage.ru_nivcsw -= before->ru_nivcsw;  // Involuntary ones too
+    st.label = node_text(cmd);  // What it ran
+    stats_write(&st, 1, 0, status, 1);  // Send the record
+    free(st.label);             // Release the text
+}
+
+int run_builtin(node *cmd) {    // Runs a shell-side command in the shell itself, honouring its redirections
+    struct rusage before;       // Shell's usage when stats are on
+    long long started = 0;      // When it began
+    if (stats_fd >= 0) started = now_ns(), getrusage(RUSAGE_SELF, &before);  // Start the clock
+    int saved[2] = {-1, -1};    // Copies of stdin/stdout while redirected
+    for (redirect *r = cmd->redirs; r; r = r->next) {  // Each stream that is about to change
+        if (saved[r->fd] >= 0) continue;  // Already saved
+        if (r->fd == STDOUT_FILENO) fflush(stdout);  // Earlier output belongs to the old stdout
+        saved[r->fd] = fcntl(r->fd, F_DUPFD_CLOEXEC, 10);  // Keep the original out of the way
+    }
+    int status = handle_redirection(cmd->redirs) < 0 ? 1 : run_shell_command(cmd);  // Redirect, then run
+    for (int fd = 0; fd < 2; fd++) {  // Put the streams back
+        if (saved[fd] < 0) continue;  // Never changed
+        if (fd == STDOUT_FILENO) fflush(stdout);  // Output goes to the redirected file
+        dup2(saved[fd], fd);    // Restore the original
+        close(saved[fd]);       // Drop the copy
+    }
+    if (saved[STDIN_FILENO] >= 0) clearerr(stdin);  // Forget any EOF seen on the redirected input
+    if (stats_fd >= 0) stats_builtin(cmd, status, started, &before);  // Report it
+    return status;              // Builtin status
+}
+
+pid_t spawn_builtin(node *cmd, int in_fd, int out_fd) {  // Runs a builtin as a pipeline stage in a forked child
+    fflush(stdout);             // Do not duplicate buffered output
+    pid_t pid = fork();         // Pipeline stages need their own process
+    if (pid == 0) {             // In the child
+        jobs_reset_in_child();  // Do not touch the parent's jobs
+        if (in_fd >= 0) dup2(in_fd, STDIN_FILENO);  // Connect input
+        if (out_fd >= 0) dup2(out_fd, STDOUT_FILENO);  // Connect output
+        int status = handle_redirection(cmd->redirs) < 0 ? 1 : run_shell_command(cmd);  // Run it
+        fflush(stdout);         // Push out its output
+        _exit(status);          // Leave with its status
+    }
+    if (pid < 0) perror("fork failed");  // Report the error
+    return pid;                 // Child pid or -1
+}
+
+// Output Memoization
+// memo cmd args... replays a command's earlier stdout and exit status when
+// nothing it depends on has changed. The key hashes argv, the working
+// directory, the resolved binary, and the identity (device, inode, size,
+// mtime_ns) of every < input and every operand that names an existing file.
+// A miss runs the command with stdout going to an O_TMPFILE inside the store,
+// which is then linked in under the hash of its contents (objects/), with a
+// small key file (keys/) pointing at it. Either way the output is sent on
+// with sendfile(), so it never passes through the shell's memory. Hits touch
+// both files, and once the store outgrows `set -o memosize` the least
+// recently used objects are deleted. The whole environment is part of the
+// key too. Only stdout is cached: stderr goes straight to the terminal. A
+// command is only memoized when its stdin is a < file, a regular file (by
+// identity and offset) or /dev/null; a pipe or terminal means it just runs.
+typedef struct {                // 128-bit hash used for keys and content addresses
+    uint64_t a, b;              // Two independent lanes
+} memo_hash;
+
+uint64_t memo_mix(uint64_t h) { // Final avalanche (MurmurHash3 fmix64)
+    h ^= h >> 33, h *= 0xff51afd7ed558ccdULL;  // Spread high bits down
+    h ^= h >> 33, h *= 0xc4ceb9fe1a85ec53ULL;  // And again
+    return h ^ (h >> 33);       // Mixed
+}
+
+memo_hash memo_hash_bytes(const void *data, size_t n) {  // Hashes a buffer 8 bytes at a time
+    const unsigned char *p = data;  // Input
+    uint64_t a = 0x9e3779b97f4a7c15ULL ^ n, b = 0xc2b2ae3d27d4eb4fULL + n;  // Seeds include the length
+    for (; n >= 8; p += 8, n -= 8) {  // Whole words
+        uint64_t w;             // Next word
+        memcpy(&w, p, 8);       // Unaligned-safe load
+        a = ((a ^ w) * 0x87c37b91114253d5ULL), a = a << 31 | a >> 33;  // Lane one
+        b = ((b ^ w) * 0x4cf5ad432745937fULL), b = (b << 29 | b >> 35) + a;  // Lane two depends on one
+    }
+    uint64_t w = 0;             // Last partial word
+    memcpy(&w, p, n);           // Up to 7 bytes
+    a ^= w, b ^= w * 0x87c37b91114253d5ULL;  // Fold it in
+    return (memo_hash){memo_mix(a + b), memo_mix(b ^ (a << 1))};  // Finish both lanes
+}
+
+void memo_hex(memo_hash h, char out[33]) {  // Hash as 32 hex digits
+    snprintf(out, 33, "%016llx%016llx", (unsigned long long)h.a, (unsigned long long)h.b);  // Fixed width
+}
+
+const char *memo_dir(void) {    // Store directory (created on first use), NULL if it cannot be made
+    static char dir[PATH_MAX];  // Resolved once
+    if (*dir) return dir;       // Already set up
+    const char *env = getenv("W25SHELL_MEMO_DIR");  // Explicit location
+    if (env && *env) snprintf(dir, sizeof(dir), "%s", env);  // Use it
+    else if (getenv("XDG_CACHE_HOME")) snprintf(dir, sizeof(dir), "%s/w25shell-memo", getenv("XDG_CACHE_HOME"));  // XDG cache
+    else if (getenv("HOME")) snprintf(dir, sizeof(dir), "%s/.cache/w25shell-memo", getenv("HOME"));  // Default cache
+    else return NULL;           // Nowhere to keep it
+    char sub[PATH_MAX + 16];    // objects/ and keys/
+    if (getenv("HOME") && !(env && *env)) {  // ~/.cache may not exist yet
+        snprintf(sub, sizeof(sub), "%s/.cache", getenv("HOME"));  // Parent
+        mkdir(sub, 0700);       // Fine if it exists
+    }
+    mkdir(dir, 0700);           // Private to the user
+    snprintf(sub, sizeof(sub), "%s/objects", dir), mkdir(sub, 0700);  // Outputs by content hash
+    snprintf(sub, sizeof(sub), "%s/keys", dir), mkdir(sub, 0700);  // Keys pointing at them
+    if (access(sub, W_OK) < 0) { *dir = '\0'; return NULL; }  // Not usable
+    return dir;                 // Ready
+}
+
+void memo_identity(FILE *key, const char *what, const struct stat *st) {  // Adds a file's identity to the key text
+    fprintf(key, "%s %llu %llu %lld %lld.%09ld%c", what, (unsigned long long)st->st_dev, (unsigned long long)st->st_ino,
+            (long long)st->st_size, (long long)st->st_mtim.tv_sec, st->st_mtim.tv_nsec, 0);  // Any change is a new key
+}
+
+int memo_env_cmp(const void *a, const void *b) {  // qsort order for environment entries
+    return strcmp(*(char *const *)a, *(char *const *)b);  // By name, then value
+}
+
+int memo_key(node *cmd, char hex[33]) {  // Builds the key for a command, 0 or -1 if it cannot be memoized
+    char *text;                 // Key text
+    size_t size;                // Its length
+    FILE *key = open_memstream(&text, &size);  // Built, then hashed
+    struct stat st;             // File identities
+    for (int i = 0; i < cmd->count; i++) fprintf(key, "%s%c", cmd->argv[i], 0);  // Every word, NUL-separated
+    char cwd[PATH_MAX];         // Relative operands depend on it
+    fprintf(key, "cwd %s%c", getcwd(cwd, sizeof(cwd)) ? cwd : "?", 0);  // Working directory
+    int ok = 1;                 // Everything identified
+    if (is_file_operation(cmd->argv)) {  // The shell runs it
+        ok = stat("/proc/self/exe", &st) == 0;  // No /proc: cannot tell which shell
+        if (ok) memo_identity(key, "shell", &st);  // This build of it
+    } else {                    // A program
+        const char *path = hash_lookup(cmd->argv[0]);  // Resolved binary
+        ok = path && stat(path, &st) == 0;  // Must exist
+        if (ok) fprintf(key, "bin %s%c", path, 0), memo_identity(key, "binary", &st);  // Which file, and which version of it
+    }
+    int redirected = 0;         // Has a < input
+    for (redirect *r = cmd->redirs; r && ok; r = r->next)  // Input files
+        if (r->fd == STDIN_FILENO && (redirected = 1, ok = stat(r->path, &st) == 0)) memo_identity(key, r->path, &st);  // Missing input: just run it
+    if (!redirected && ok) {    // Reads the shell's own stdin
+        ok = fstat(STDIN_FILENO, &st) == 0;  // Closed stdin: just run it
+        if (ok && S_ISREG(st.st_mode)) {  // A file: its identity and where reading starts
+            memo_identity(key, "stdin", &st);  // Which file, which version
+            fprintf(key, "at %lld%c", (long long)lseek(STDIN_FILENO, 0, SEEK_CUR), 0);  // Offset
+        } else if (ok && S_ISCHR(st.st_mode) && st.st_rdev == makedev(1, 3)) fprintf(key, "stdin null%c", 0);  // /dev/null: nothing to read
+        else ok = 0;            // Pipe, terminal, socket: output depends on data we cannot see
+    }
+    int nenv = 0;               // Environment entries
+    while (environ[nenv]) nenv++;  // Count them
+    char **env = malloc((nenv + 1) * sizeof(char *));  // Sorted copy, so the order they were set in does not matter
+    memcpy(env, environ, nenv * sizeof(char *));  // Pointers only
+    qsort(env, nenv, sizeof(char *), memo_env_cmp);  // By name
+    for (int i = 0; i < nenv; i++) fprintf(key, "env %s%c", env[i], 0);  // PATH, locale and everything else the command sees
+    free(env);                  // Done with the copy
+    for (int i = 1; i < cmd->count; i++)  // Operands that are files
+        if (stat(cmd->argv[i], &st) == 0) memo_identity(key, cmd->argv[i], &st);  // Options and other words are in argv already
+    fclose(key);                // Finish the text
+    memo_hex(memo_hash_bytes(text, size), hex);  // Hash it
+    free(text);                 // Release it
+    return ok ? 0 : -1;         // Usable?
+}
+
+int memo_send(int fd) {         // Copies a stored output to stdout with sendfile(), 0 or -1
+    struct stat st;             // Its size
+    if (fstat(fd, &st) < 0) return -1;  // Should not happen
+    fflush(stdout);             // Earlier output first
+    off_t off = 0;              // Read position (the file's own offset is untouched)
+    while (off < st.st_size) {  // Until everything is sent
+        ssize_t n = sendfile(STDOUT_FILENO, fd, &off, st.st_size - off);  // Page cache to stdout
+        if (n > 0) continue;    // Progress (off advanced)
+        if (n < 0 && errno == EINTR) continue;  // Interrupted
+        if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {  // Output that sendfile() cannot write to
+            char buf[65536];    // Copy the rest the plain way
+            ssize_t r;          // Bytes read
+            while ((r = pread(fd, buf, sizeof(buf), off)) > 0) {  // Rest of the file
+                if (write(STDOUT_FILENO, buf, r) != r) return -1;  // Reader went away
+                off += r;       // Advance
+            }
+            return 0;           // Done
+        }
+        return -1;              // EPIPE and friends: the reader went away
+    }
+    return 0;                   // Sent it all
+}
+
+int memo_deliver(int fd, redirect *outs) {  // Sends a stored output to stdout, honouring the command's > and >>
+    int saved = -1;             // Original stdout while redirected
+    if (outs) fflush(stdout), saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);  // Keep it out of the way
+    int ok = handle_redirection(outs) == 0 && memo_send(fd) == 0;  // Redirect, then send
+    if (saved >= 0) dup2(saved, STDOUT_FILENO), close(saved);  // Put stdout back
+    return ok ? 0 : -1;         // Delivered?
+}
+
+void memo_evict(const char *dir) {  // Deletes least recently used objects until the store fits memo_size_cap
+    char path[PATH_MAX + 64];   // objects/ and keys/
+    snprintf(path, sizeof(path), "%s/objects", dir);  // Objects first
+    int dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);  // The directory
+    if (dfd < 0 || flock(dfd, LOCK_EX | LOCK_NB) < 0) { if (dfd >= 0) close(dfd); return; }  // Another shell is already evicting
+    typedef struct { struct timespec used; off_t size; char name[33]; } memo_object;  // One stored output
+    memo_object *objs = NULL;   // Every object
+    int count = 0, cap = 0;     // How many, room
+    long long total = 0;        // Their combined size
+    DIR *d = fdopendir(dup(dfd));  // List them
+    for (struct dirent *e; d && (e = readdir(d)); ) {  // Each entry
+        struct stat st;         // Its size and last use
+        if (strlen(e->d_name) != 32 || fstatat(dfd, e->d_name, &st, 0) < 0) continue;  // Only objects
+        if (count == cap) cap = cap ? cap * 2 : 64, objs = realloc(objs, cap * sizeof(memo_object));  // Grow
+        objs[count].used = st.st_mtim, objs[count].size = st.st_blocks * 512LL;  // Space it really takes
+        memcpy(objs[count++].name, e->d_name, 33);  // And its name
+        total += st.st_blocks * 512LL;  // Running total
+    }
+    if (d) closedir(d);         // Done listing
+    while (total > memo_size_cap && count) {  // Oldest first until it fits
+        int oldest = 0;         // Least recently used so far
+        for (int i = 1; i < count; i++)  // Find it (eviction is rare, so a scan is fine)
+            if (objs[i].used.tv_sec < objs[oldest].used.tv_sec ||
+                (objs[i].used.tv_sec == objs[oldest].used.tv_sec && objs[i].used.tv_nsec < objs[oldest].used.tv_nsec)) oldest = i;  // Older
+        unlinkat(dfd, objs[oldest].name, 0);  // Drop it (keys pointing at it become misses)
+        total -= objs[oldest].size;  // Freed
+        objs[oldest] = objs[--count];  // Remove it from the list
+    }
+    free(objs);                 // Done with the list
+    snprintf(path, sizeof(path), "%s/keys", dir);  // Then keys whose objects are gone
+    DIR *k = opendir(path);     // List them
+    for (struct dirent *e; k && (e = readdir(k)); ) {  // Each key
+        char object[33] = "";   // Object it points at
+        FILE *fp = strlen(e->d_name) == 32 ? fopen((snprintf(path, sizeof(path), "%s/keys/%s", dir, e->d_name), path), "r") : NULL;  // Open it
+        if (!fp) continue;      // Not a key
+        int valid = fscanf(fp, "%32s", object) == 1 && faccessat(dfd, object, F_OK, 0) == 0;  // Object still there?
+        fclose(fp);             // Done reading
+        if (!valid) unlink(path);  // Dangling: drop it
+    }
+    if (k) closedir(k);         // Done listing
+    close(dfd);                 // Releases the lock too
+}
+
+int memo_lookup(const char *dir, const char *hex, int *status) {  // Opens the stored output for a key, -1 on a miss
+    char path[PATH_MAX + 64], object[33];  // Key file, object name
+    snprintf(path, sizeof(path), "%s/keys/%s", dir, hex);  // Key file
+    FILE *fp = fopen(path, "re");  // Holds "object status"
+    if (!fp) return -1;         // Never ran
+    int ok = fscanf(fp, "%32s %d", object, status) == 2;  // Parse it
+    futimens(fileno(fp), NULL); // Recently used
+    fclose(fp);                 // Done with the key
+    if (!ok) return -1;         // Corrupt: treat as a miss
+    snprintf(path, sizeof(path), "%s/objects/%s", dir, object);  // The output
+    int fd = open(path, O_RDONLY | O_CLOEXEC);  // Open it
+    if (fd >= 0) futimens(fd, NULL);  // Recently used (protects it from eviction)
+    return fd;                  // Evicted objects are misses
+}
+
+void memo_store(const char *dir, const char *hex, int fd, int status) {  // Publishes a fresh output under its content hash and points the key at it
+    struct stat st;             // Its size
+    if (fstat(fd, &st) < 0) return;  // Should not happen
+    void *map = st.st_size ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;  // Hash it in place
+    if (map == MAP_FAILED) return;  // Cannot hash it: do not cache
+    char object[33], path[PATH_MAX + 64], tmp[PATH_MAX + 96], proc[64];  // Names
+    memo_hex(memo_hash_bytes(map ? map : "", st.st_size), object);  // Content address
+    if (map) munmap(map, st.st_size);  // Done hashing
+    snprintf(path, sizeof(path), "%s/objects/%s", dir, object);  // Where it goes
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);  // The O_TMPFILE
+    if (linkat(AT_FDCWD, proc, AT_FDCWD, path, AT_SYMLINK_FOLLOW) < 0 && errno != EEXIST) return;  // Same output already stored is fine
+    if (errno == EEXIST) utimensat(AT_FDCWD, path, NULL, 0);  // Existing copy is in use again
+    snprintf(path, sizeof(path), "%s/keys/%s", dir, hex);  // Key file
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());  // Written aside, then renamed over
+    FILE *fp = fopen(tmp, "we"); // New key
+    if (!fp) return;            // Store not writable
+    fprintf(fp, "%s %d\n", object, status);  // Object and exit status
+    if (fclose(fp) == 0) rename(tmp, path);  // Atomic against other shells
+    else unlink(tmp);           // Disk full
+}
+
+int execute_memo(node *cmd) {   // memo cmd: replays a stored result or runs the command and stores it
+    int builtin = cmd->argv[0] && !is_file_operation(cmd->argv) && builtin_find(cmd->argv[0]);  // Builtins act on the shell itself
+    const char *dir = builtin || !cmd->argv[0] ? NULL : memo_dir();  // Store, if this can be memoized at all
+    char hex[33];               // Key
+    if (!dir || memo_key(cmd, hex) < 0) return is_shell_command(cmd) ? run_builtin(cmd) : execute_command(cmd);  // Just run it
+    int nredirs = 0;            // Redirections on the command
+    for (redirect *r = cmd->redirs; r; r = r->next) nredirs++;  // Count them
+    redirect copies[nredirs + 1];  // Split copies, so the node's list is untouched
+    redirect *ins = NULL, *outs = NULL, **in_tail = &ins, **out_tail = &outs;  // < applies to the run, > and >> to the delivery
+    for (redirect *r = cmd->redirs, *c = copies; r; r = r->next, c++) {  // Split them
+        *c = *r, c->next = NULL;  // Same target
+        if (r->fd == STDIN_FILENO) *in_tail = c, in_tail = &c->next;  // Input
+        else *out_tail = c, out_tail = &c->next;  // Output
+    }
+    int status;                 // Stored or fresh exit status
+    int fd = memo_lookup(dir, hex, &status);  // Hit?
+    if (fd >= 0) {              // Replay it
+        if (memo_deliver(fd, outs) < 0 && errno != EPIPE) status = 1;  // Could not write the output
+        close(fd);              // Done
+        return status;          // As if it ran
+    }
+    char objects[PATH_MAX + 16];  // Where the output is captured
+    snprintf(objects, sizeof(objects), "%s/objects", dir);  // Inside the store, so linking it in is free
+    fd = open(objects, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);  // Anonymous until published
+    if (fd < 0) return is_shell_command(cmd) ? run_builtin(cmd) : execute_command(cmd);  // Filesystem without O_TMPFILE: just run it
+    redirect *all = cmd->redirs;  // Restored afterwards
+    cmd->redirs = ins;          // The run only sees its inputs
+    if (is_shell_command(cmd)) {  // File operation: runs in the shell with stdout on the capture
+        fflush(stdout);         // Earlier output first
+        int saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);  // Keep stdout
+        dup2(fd, STDOUT_FILENO);  // Capture
+        status = run_builtin(cmd);  // Run it
+        fflush(stdout);         // Into the capture
+        dup2(saved, STDOUT_FILENO), close(saved);  // Put stdout back
+    } else {                    // Program: one stage writing to the capture
+        job *j = job_new(1, 0); // Tracked like any command
+        pipe_config cfg = pipe_effective(NULL);  // No pipes, but launch_stages wants settings
+        launch_stages(j, 0, &cmd, 0, 0, -1, fd, &cfg);  // Start it
+        status = job_wait(j);   // Wait for it
+        job_remove(j);          // Forget it
+    }
+    cmd->redirs = all;          // Node as parsed
+    if (status < 126) memo_store(dir, hex, fd, status);  // Not found, not executable and killed are not results
+    if (memo_deliver(fd, outs) < 0 && errno != EPIPE) status = 1;  // Show what it printed
+    close(fd);                  // The store has its own link now
+    if (status < 126) memo_evict(dir);  // Keep the store under its cap
+    return status;              // The command's status
+}
+
+// Command Lexer
+typedef enum {                  // Token kinds
+    TOK_WORD,                   // Ordinary (possibly quoted) word
+    TOK_PIPE,                   // |
+    TOK_RPIPE,                  // = (reverse pipe, only at the start of a token)
+    TOK_FANOUT,                 // |> (copy the stream to another branch)
+    TOK_AND,                    // &&
+    TOK_OR,                     // ||
+    TOK_SEMI,                   // ;
+    TOK_IN,                     // <
+    TOK_OUT,                    // >
+    TOK_APPEND,                 // >>
+    TOK_AMP,                    // & (run in the background)
+    TOK_END,                    // End of line
+    TOK_ERROR                   // Lexical error (message in parser.error)
+} token_type;
+
+const char *token_names[] = {"word", "|", "=", "|>", "&&", "||", ";", "<", ">", ">>", "&", "newline", "error"};  // For error messages
+
+typedef struct {                // Lexer and parser state for one line
+    const char *p;              // Next unread input character
+    char *out;                  // Where the next unquoted word is written
+    token_type type;            // Current token
+    char *text;                 // Current word (TOK_WORD only)
+    const char *error;          // Syntax error message, NULL if none
+    arena *arena;               // Where words and nodes live
+    int subst;                  // Current word contains $(...)
+    int glob;                   // Current word contains an unquoted glob character
+    int test_args;              // Inside test or [ ...: a bare = is an operand, not a pipe
+} parser;
+
+const char *lex_subst(parser *ps, const char *p, char **out, int quoted) {  // Copies $(...) at p into the word as marked raw text, returns what follows
+    const char *start = p + 2;  // After $(
+    int depth = 1;              // Open parentheses
+    for (p = start; *p && depth; p++) {  // Find the matching )
+        if (*p == '\\' && p[1]) p++;  // Escaped character
+        else if (*p == '\'') { const char *q = strchr(p + 1, '\''); if (!q) break; p = q; }  // Single-quoted text
+        else if (*p == '"') { for (p++; *p && *p != '"'; p++) if (*p == '\\' && p[1]) p++; if (!*p) break; }  // Double-quoted text
+        else if (*p == '(') depth++;  // Nested
+        else if (*p == ')') depth--;  // Closed one
+    }
+    if (depth) { ps->type = TOK_ERROR; ps->error = "syntax error: unterminated $("; return NULL; }  // Ran off the end
+    *(*out)++ = quoted ? SUBST_QUOTED[0] : SUBST_OPEN[0];  // Mark the start
+    memcpy(*out, start, p - 1 - start);  // Raw command text, parsed when it runs
+    *out += p - 1 - start;      // Advance output
+    *(*out)++ = SUBST_CLOSE[0]; // Mark the end
+    ps->subst = 1;              // Command needs expanding
+    return p;                   // After the )
+}
+
+int is_word_end(char c) {       // Characters that end an unquoted word
+    return c == '\0' || c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+           c == '|' || c == '&' || c == ';' || c == '<' || c == '>';  // Whitespace or an operator
+}
+
+void lex_next(parser *ps) {     // Reads the next token in one pass over the line
+    const char *p = ps->p;      // Read position
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;  // Skip blanks
+    ps->text = NULL;            // Only words carry text
+    switch (*p) {               // Operators first
+        case '\0': ps->type = TOK_END; ps->p = p; return;  // End of line
+        case '|': ps->type = p[1] == '|' ? TOK_OR : p[1] == '>' ? TOK_FANOUT : TOK_PIPE; ps->p = p + (p[1] == '|' || p[1] == '>' ? 2 : 1); return;  // ||, |> or |
+        case ';': ps->type = TOK_SEMI; ps->p = p + 1; return;  // ;
+        case '<': ps->type = TOK_IN; ps->p = p + 1; return;  // <
+        case '>': ps->type = p[1] == '>' ? TOK_APPEND : TOK_OUT; ps->p = p + (p[1] == '>' ? 2 : 1); return;  // >> or >
+        case '=': if (ps->test_args) break;  // test a = b: lexed as a word below
+                  ps->type = TOK_RPIPE; ps->p = p + 1; return;  // = (a=b inside a word stays a word)
+        case '&': ps->type = p[1] == '&' ? TOK_AND : TOK_AMP; ps->p = p + (p[1] == '&' ? 2 : 1); return;  // && or &
+    }
+
+    char *out = ps->out;        // Word is unquoted into the line's word buffer
+    ps->text = out;             // Word starts here
+    ps->subst = ps->glob = 0;   // No $(...) or glob characters seen yet
+    while (!is_word_end(*p)) {  // Until whitespace or an operator
+        if (*p == '$' && p[1] == '(') {  // Command substitution
+            if (!(p = lex_subst(ps, p, &out, 0))) return;  // Error recorded
+        } else if (*p == '\'') {       // Single quotes: everything literal
+            const char *close = strchr(p + 1, '\'');  // Matching quote
+            if (!close) { ps->type = TOK_ERROR; ps->error = "syntax error: unterminated '"; return; }  // Missing it
+            memcpy(out, p + 1, close - p - 1);  // Copy the contents
+            out += close - p - 1;  // Advance output
+            p = close + 1;      // Continue after the quote
+        } else if (*p == '"') { // Double quotes: backslash escapes \ " $ `
+            for (p++; *p != '"'; p++) {  // Until the closing quote
+                if (!*p) { ps->type = TOK_ERROR; ps->error = "syntax error: unterminated \""; return; }  // Missing it
+                if (*p == '$' && p[1] == '(') {  // "$(...)"
+                    if (!(p = lex_subst(ps, p, &out, 1))) return;  // Error recorded
+                    p--;        // Loop steps past the )
+                    continue;   // Next character
+                }
+                if (*p == '\\' && (p[1] == '"' || p[1] == '\\' || p[1] == '$' || p[1] == '`')) p++;  // Escaped character
+                *out++ = *p;    // Copy it
+            }
+            p++;                // Skip the closing quote
+        } else if (*p == '\\') {  // Backslash quotes the next character
+            if (p[1]) *out++ = p[1], p += 2;  // Copy it literally
+            else p++;           // Trailing backslash is dropped
+        } else {                // Ordinary character
+            if (strchr("*?[]{},", *p)) *out++ = GLOB_MARK[0], ps->glob = 1;  // Unquoted: may expand
+            *out++ = *p++;      // Copy it
+        }
+    }
+    *out++ = '\0';              // Terminate the word
+    ps->out = out;              // Next word goes after it
+    ps->type = TOK_WORD;        // It's a word
+    ps->p = p;                  // Continue from here
+}
+
+// Command Parser
+void syntax_error(parser *ps) { // Records an unexpected-token error (keeps the first one)
+    if (ps->error) return;      // Already have an error
+    char *msg = arena_alloc(ps->arena, 64);  // Room for the message
+    snprintf(msg, 64, "syntax error near unexpected token `%s'", token_names[ps->type]);  // Name the token
+    ps->error = msg;            // Report it
+}
+
+node *new_node(parser *ps, node_type type) {  // Zeroed node in the line arena
+    node *n = arena_alloc(ps->arena, sizeof(node));  // Space for it
+    memset(n, 0, sizeof(node)); // Clear every field
+    n->type = type;             // Set its kind
+    return n;                   // New node
+}
+
+int is_test_command(char **words, int count) {  // Whether words so far start test or [ (after any time/memo prefix)
+    int i = 0;                  // Skip the prefixes
+    while (i < count - 1 && (strcmp(words[i], "time") == 0 || strcmp(words[i], "memo") == 0)) i++;  // time memo test ...
+    return i == count - 1 && (strcmp(words[i], "test") == 0 || strcmp(words[i], "[") == 0 || strcmp(words[i], GLOB_MARK "[") == 0);  // Last word is the builtin's name (an unquoted [ carries the glob mark)
+}
+
+node *parse_command(parser *ps) {  // command := (WORD | redirection)+
+    node *cmd = new_node(ps, NODE_COMMAND);  // The command node
+    ptr_list words = {0};       // Its argument vector
+    redirect **tail = &cmd->redirs;  // Where the next redirection is linked
+    while (1) {                 // Words and redirections in any order
+        if (ps->type == TOK_WORD) {  // Argument
+            if (ps->subst || ps->glob) cmd->expand = ps->arena;  // Has $(...) or globs to expand later
+            list_push(ps->arena, &words, ps->text);  // Add it to argv
+            if (is_test_command((char **)words.items, words.count)) ps->test_args = 1;  // Its = is the string operator
+            lex_next(ps);       // Next token
+        } else if (ps->type == TOK_IN || ps->type == TOK_OUT || ps->type == TOK_APPEND) {  // Redirection
+            redirect *r = arena_alloc(ps->arena, sizeof(redirect));  // New redirection
+            r->fd = ps->type == TOK_IN ? STDIN_FILENO : STDOUT_FILENO;  // Which stream it replaces
+            r->flags = ps->type == TOK_IN ? O_RDONLY : ps->type == TOK_OUT ? O_WRONLY | O_CREAT | O_TRUNC : O_WRONLY | O_CREAT | O_APPEND;  // How to open the file
+            r->next = NULL;     // Last one so far
+            lex_next(ps);       // Filename should follow
+            if (ps->type != TOK_WORD) { syntax_error(ps); return NULL; }  // Missing filename
+            r->path = ps->text; // Remember it
+            if (ps->subst || ps->glob) cmd->expand = ps->arena;  // Has $(...) or globs to expand later
+            *tail = r;          // Link it in
+            tail = &r->next;    // Next one goes after it
+            lex_next(ps);       // Next token
+        } else {                // Anything else ends the command
+            break;              // Done
+        }
+    }
+    ps->test_args = 0;          // = is a pipe again after the command
+    if (ps->error) return NULL; // Lexer error inside the command
+    if (!words.count && !cmd->redirs) { syntax_error(ps); return NULL; }  // Empty command
+    if (!words.count) {         // Redirection-only command
+        words.items = arena_alloc(ps->arena, sizeof(void *));  // Still gets a valid argv
+        words.items[0] = NULL;  // That is empty
+    }
+    cmd->argv = (char **)words.items;  // NULL-terminated argv
+    cmd->count = words.count;   // Number of words
+    return cmd;                 // Parsed command
+}
+
+node *parse_pipeline(parser *ps) {  // pipeline := command ('|' command)* | command ('=' command)*
+    node *first = parse_command(ps);  // First stage
+    int timed = first && first->count > 1 && strcmp(first->argv[0], "time") == 0;  // time prefix covers the whole pipeline
+    if (timed) first->argv++, first->count--;  // Drop the keyword
+    pipe_config *tuning = NULL; // pipe [-s SIZE] [-p] [-m] prefix
+    if (first && first->count > 1 && strcmp(first->argv[0], "pipe") == 0) {  // Per-pipeline pipe settings
+        tuning = arena_alloc(ps->arena, sizeof(pipe_config));  // Lives as long as the tree
+        *tuning = (pipe_config){0, 0, 0};  // Nothing overridden yet
+        first->argv++, first->count--;  // Drop the keyword
+        while (first->count > 1 && first->argv[0][0] == '-') {  // Options come before the command
+            const char *opt = first->argv[0];  // This option
+            if (strcmp(opt, "-p") == 0) tuning->packet = 1;  // Packet mode
+            else if (strcmp(opt, "-m") == 0) tuning->meter = 1;  // Meter
+            else if (strcmp(opt, "-s") == 0 && first->count > 2) {  // Size
+                long size = pipe_size_parse(first->argv[1]);  // Parse it
+                if (size < 0) { ps->error = "pipe: bad size (use bytes, NNk, NNm or max)"; return NULL; }  // Not a size
+                tuning->size = size;  // Use it
+                first->argv++, first->count--;  // Skip the value
+            } else { ps->error = "pipe: usage: pipe [-s SIZE] [-p] [-m] pipeline"; return NULL; }  // Unknown option
+            first->argv++, first->count--;  // Next word
+        }
+    }
+    if (first && first->count > 1 && strcmp(first->argv[0], "memo") == 0) {  // Memoized command
+        if (tuning) { ps->error = "memo: cannot memoize a pipe-prefixed pipeline"; return NULL; }  // Single commands only
+        first->argv++, first->count--;  // Drop the keyword
+        first->memo = 1;        // Mark it
+    }
+    if (first && first->memo && (ps->type == TOK_PIPE || ps->type == TOK_RPIPE)) { ps->error = "memo: only single commands can be memoized"; return NULL; }  // Pipelines have no single identity
+    if (first && ps->type != TOK_PIPE && ps->type != TOK_RPIPE) first->timed = timed;  // Timed plain command
+    if (!first || (ps->type != TOK_PIPE && ps->type != TOK_RPIPE)) return first;  // Plain command
+    token_type op = ps->type;   // | or =, never both
+    ptr_list stages = {0};      // All stages
+    list_push(ps->arena, &stages, first);  // First stage
+    while (ps->type == TOK_PIPE || ps->type == TOK_RPIPE) {  // More stages
+        if (ps->type != op) { ps->error = "syntax error: cannot mix | and = in one pipeline"; return NULL; }  // Direction must not change
+        lex_next(ps);           // Skip the operator
+        node *stage = parse_command(ps);  // Next stage
+        if (!stage) return NULL;  // Error already recorded
+        list_push(ps->arena, &stages, stage);  // Add it
+    }
+    node *pipeline = new_node(ps, NODE_PIPELINE);  // Pipeline node
+    pipeline->items = (node **)stages.items;  // Its stages
+    pipeline->count = stages.count;  // How many
+    pipeline->reverse = op == TOK_RPIPE;  // Direction of data flow
+    pipeline->timed = timed;    // time prefix
+    pipeline->tuning = tuning;  // pipe prefix
+    return pipeline;            // Parsed pipeline
+}
+
+node *parse_fanout(parser *ps) {  // fanout := pipeline ('|>' pipeline)*
+    node *first = parse_pipeline(ps);  // Producer
+    if (!first || ps->type != TOK_FANOUT) return first;  // Plain pipeline
+    ptr_list items = {0};       // Producer, then every branch
+    list_push(ps->arena, &items, first);  // Producer
+    while (ps->type == TOK_FANOUT) {  // More branches
+        lex_next(ps);           // Skip the operator
+        node *branch = parse_pipeline(ps);  // Next branch
+        if (!branch) return NULL;  // Error already recorded
+        list_push(ps->arena, &items, branch);  // Add it
+    }
+    node *fanout = new_node(ps, NODE_FANOUT);  // Fan-out node
+    fanout->items = (node **)items.items;  // Producer and branches
+    fanout->count = items.count;  // How many
+    return fanout;              // Parsed fan-out
+}
+
+node *parse_conditional(parser *ps) {  // conditional := fanout (('&&' | '||') fanout)*
+    node *first = parse_fanout(ps);  // First fan-out (usually a plain pipeline)
+    if (!first || (ps->type != TOK_AND && ps->type != TOK_OR)) return first;  // No operators
+    ptr_list items = {0}, ops = {0};  // Pipelines and the operators between them
+    list_push(ps->arena, &items, first);  // First pipeline
+    while (ps->type == TOK_AND || ps->type == TOK_OR) {  // More pipelines
+        list_push(ps->arena, &ops, ps->type == TOK_AND ? "&&" : "||");  // Remember the operator
+        lex_next(ps);           // Skip it
+        node *next = parse_fanout(ps);  // Next pipeline
+        if (!next) return NULL; // Error already recorded
+        list_push(ps->arena, &items, next);  // Add it
+    }
+    node *cond = new_node(ps, NODE_CONDITIONAL);  // Conditional node
+    cond->items = (node **)items.items;  // Its pipelines
+    cond->operators = (char **)ops.items;  // Operators between them
+    cond->count = items.count;  // How many
+    return cond;                // Parsed conditional
+}
+
+node *parse_sequence(parser *ps) {  // sequence := conditional ((';' | '&') conditional)* [';' | '&']
+    ptr_list items = {0};       // Conditionals in order
+    while (ps->type != TOK_END) {  // Until the end of the line
+        node *item = parse_conditional(ps);  // Next conditional
+        if (!item) return NULL; // Error already recorded
+        list_push(ps->arena, &items, item);  // Add it
+        if (ps->type != TOK_SEMI && ps->type != TOK_AMP) break;  // No separator: must be the end
+        item->background = ps->type == TOK_AMP;  // & runs it without waiting
+        lex_next(ps);           // Skip the separator
+    }
+    if (ps->type != TOK_END) { syntax_error(ps); return NULL; }  // Leftover tokens
+    if (items.count <= 1) return items.count ? items.items[0] : NULL;  // Single item or empty line
+    node *seq = new_node(ps, NODE_SEQUENCE);  // Sequence node
+    seq->items = (node **)items.items;  // Its conditionals
+    seq->count = items.count;   // How many
+    return seq;                 // Parsed sequence
+}
+
+node *parse_line(arena *a, const char *input, const char **error) {  // Parses one line into an AST, NULL if empty or on error
+    parser ps = {0};            // Fresh parser
+    ps.p = input;               // Start of the line
+    ps.arena = a;               // Allocate from the line arena
+    ps.out = arena_alloc(a, 2 * strlen(input) + 2);  // Unquoted words never need more than this
+    lex_next(&ps);              // Prime the first token
+    node *tree = parse_sequence(&ps);  // Parse everything
+    *error = ps.error;          // Report any syntax error
+    return ps.error ? NULL : tree;  // Result
+}
+
+// Command Parser and Executor
+arena line_arena;               // Everything allocated while handling the current line
+
+int execute_single(node *cmd) { // Runs one command node that is not part of a pipeline
+    expand_command(cmd);        // Run any $(...) first
+    if (cmd->memo) return execute_memo(cmd);  // Replay or run and store
+    if (is_shell_command(cmd)) return run_builtin(cmd);  // Builtins and file operations never fork
+    return execute_command(cmd);  // Run the program
+}
+
+int execute_node(node *n) {     // Runs any node and returns its exit status
+    if (n->background) return execute_background(n);  // cmd &
+    if (n->timed) return execute_timed(n);  // time pipeline
+    switch (n->type) {          // Dispatch on the node kind
+        case NODE_COMMAND: return execute_single(n);  // Single command
+        case NODE_PIPELINE:     // | or = chain
+            if (n->reverse) return execute_reverse_piped_commands(n->items, n->count - 1, n->tuning);  // Run reverse pipes
+            return execute_piped_commands(n->items, n->count - 1, n->tuning);  // Run normal pipes
+        case NODE_FANOUT: return execute_fanout(n);  // |> branches
+        case NODE_CONDITIONAL: return execute_conditional_commands(n->items, n->count, n->operators);  // && and ||
+        case NODE_SEQUENCE: return execute_sequential_commands(n->items, n->count);  // ; list
+    }
+    return 1;                   // Unknown node
+}
+
+int parse_and_execute(char *input) {  // Main function to parse and run commands, returns the exit status
+    const char *error = NULL;   // Syntax error, if any
+    int status = 0;             // Exit status of the line
+    history_add(input);         // Record it (only interactive shells keep history)
+    node *tree = parse_line(&line_arena, input, &error);  // Parse the whole line in one pass
+    if (error) fprintf(stderr, "w25shell: %s\n", error), status = 2;  // Report bad syntax
+    else if (tree) status = execute_node(tree);  // Run it
+    arena_reset(&line_arena);   // Release everything the line allocated
+    return status;              // Line's status
+}
+
+// Script Input
+// Batch mode (script file, -c, or stdin that is not a terminal) reads input
+// in large blocks, or maps regular files, and hands out lines of any length.
+#define SCRIPT_BLOCK (1 << 20)  
+
+typedef struct {                // Line source for batch mode
+    int fd;                     // Where more text comes from (-1 = none)
+    char *buf;                  // Buffered, mapped or in-memory text
+    size_t start;               // Start of the next unread line
+    size_t scanned;             // Bytes after start already searched for '\n'
+    size_t len;                 // Valid bytes in buf
+    size_t cap;                 // Allocated size of buf (0 when mapped)
+    size_t map_len;             // Length of the mapping, 0 if buf is not mapped
+    int eof;                    // fd has nothing more to give
+    int wait_events;            // Run the job event loop while waiting for input (interactive)
+    char *tail;                 // Copy of a mapped last line with no newline
+} line_reader;
+
+void reader_open_fd(line_reader *r, int fd) {  // Reads lines from fd, mapping it when it is a regular file
+    memset(r, 0, sizeof(*r));   // Start empty
+    r->fd = fd;                 // Source descriptor
+    struct stat st;             // File info
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {  // Regular file: map it
+        char *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);  // Private, so newlines can become NULs
+        if (map != MAP_FAILED) {  // Mapping worked
+            madvise(map, st.st_size, MADV_SEQUENTIAL);  // We read it front to back
+            r->buf = map;       // Text is the mapping
+            r->len = r->map_len = st.st_size;  // All of it is valid
+            r->eof = 1;         // Nothing more to read
+            lseek(fd, 0, SEEK_END);  // Commands reading stdin do not re-read the script
+        }
+    }
+}
+
+void reader_open_text(line_reader *r, const char *text) {  // Reads lines from a string (-c)
+    memset(r, 0, sizeof(*r));   // Start empty
+    r->fd = -1;                 // No descriptor
+    r->buf = strdup(text);      // Private, writable copy
+    r->len = strlen(text);      // Its length
+    r->cap = r->len + 1;        // Room for the terminator
+    r->eof = 1;                 // Nothing more to read
+}
+
+char *reader_next(line_reader *r) {  // Next line without its newline, NULL at end of input
+    while (1) {                 // Until we have a whole line
+        char *line = r->buf + r->start;  // Candidate line
+        char *nl = r->len > r->start + r->scanned ? memchr(line + r->scanned, '\n', r->len - r->start - r->scanned) : NULL;  // Search new bytes only
+        if (nl) {               // Complete line
+            *nl = '\0';         // Terminate it in place
+            r->start = nl - r->buf + 1;  // Next line starts after it
+            r->scanned = 0;     // Nothing searched there yet
+            return line;        // Hand it out
+        }
+        r->scanned = r->len - r->start;  // Everything buffered has been searched
+        if (r->eof) {           // No more input coming
+            if (r->start >= r->len) return NULL;  // Nothing left at all
+            size_t n = r->len - r->start;  // Final line without a newline
+            r->start = r->len;  // Consume it
+            if (r->map_len) {   // Cannot terminate past the end of a mapping
+                free(r->tail);  // Drop any older copy
+                r->tail = strndup(line, n);  // Terminated copy
+                return r->tail; // Hand it out
+            }
+            line[n] = '\0';     // Buffers always keep one spare byte
+            return line;        // Hand it out
+        }
+        if (r->start) {         // Move the partial line to the front
+            memmove(r->buf, r->buf + r->start, r->len - r->start);  // Slide it down
+            r->len -= r->start; // Less data before it
+            r->start = 0;       // Line now starts at the front
+        }
+        if (r->cap - r->len < SCRIPT_BLOCK + 1) {  // Need room for another block and a terminator
+            r->cap = r->len + 2 * SCRIPT_BLOCK;  // Grow to fit long lines
+            r->buf = realloc(r->buf, r->cap);  // Resize
+            if (!r->buf) {      // Out of memory
+                perror("realloc failed");  // Report the error
+                exit(1);        // Nothing sensible left to do
+            }
+        }
+        if (r->wait_events) event_loop(NULL, r->fd);  // Keep reaping background jobs until input arrives
+        ssize_t n = read(r->fd, r->buf + r->len, SCRIPT_BLOCK);  // One large read
+        if (n < 0 && errno == EINTR) continue;  // Interrupted, try again
+        if (n <= 0) r->eof = 1; // End of input (or an error)
+        else r->len += n;       // More text
+    }
+}
+
+int reader_buffered(line_reader *r) {  // Whether reader_next() can return without waiting for more input
+    if (r->eof) return 1;       // Mapped file, -c text, or input already ended
+    size_t unscanned = r->len - r->start - r->scanned;  // Bytes not yet searched for '\n'
+    return unscanned && memchr(r->buf + r->start + r->scanned, '\n', unscanned) != NULL;  // A whole line is waiting
+}
+
+void reader_close(line_reader *r) {  // Releases the reader's memory
+    if (r->map_len) munmap(r->buf, r->map_len);  // Unmap a mapped file
+    else free(r->buf);          // Or free the buffer
+    free(r->tail);              // And any copied last line
+}
+
+// Parse-ahead: a helper thread tokenizes and parses the next line into its own
+// arena while the current line's commands are running.
+typedef struct {                // Hand-off between the main thread and the parser thread
+    pthread_t thread;           // The parser thread
+    sem_t job_ready;            // Posted when input/arena are set
+    sem_t job_done;             // Posted when tree/error are set
+    const char *input;          // Line to parse (NULL = exit)
+    arena *arena;               // Where to put it
+    node *tree;                 // Result
+    const char *error;          // Syntax error, if any
+} parse_ahead;
+
+void *parse_ahead_thread(void *arg) {  // Parses whatever line it is given
+    parse_ahead *pa = arg;      // Shared state
+    while (1) {                 // One line per job
+        sem_wait(&pa->job_ready);  // Wait for work
+        if (!pa->input) return NULL;  // Asked to stop
+        pa->tree = parse_line(pa->arena, pa->input, &pa->error);  // Parse it
+        sem_post(&pa->job_done);  // Result is ready
+    }
+}
+
+int run_batch(line_reader *r, int use_parse_ahead) {  // Runs every line with no prompt, returns the last status
+    arena arenas[2] = {{0}, {0}};  // Current line's arena and the one being parsed ahead
+    parse_ahead pa;             // Parser thread state
+    if (use_parse_ahead) {      // Start the helper thread
+        sem_init(&pa.job_ready, 0, 0);  // No job yet
+        sem_init(&pa.job_done, 0, 0);   // No result yet
+        if (pthread_create(&pa.thread, NULL, parse_ahead_thread, &pa) != 0) use_parse_ahead = 0;  // Fall back to inline parsing
+    }
+
+    int status = 0, cur = 0;    // Last exit status and which arena holds the current line
+    const char *error = NULL;   // Current line's syntax error
+    char *line = reader_next(r);  // First line
+    node *tree = line ? parse_line(&arenas[cur], line, &error) : NULL;  // Parse it here
+    while (line) {              // One line at a time
+        jobs_notify();          // Forget finished background jobs
+        int prefetched = reader_buffered(r);  // Only look ahead when that cannot block (a pipe's writer may wait for our output)
+        char *next = prefetched ? reader_next(r) : NULL;  // Fetch the next line before running this one
+        int posted = next && use_parse_ahead;  // Parsed by the helper meanwhile
+        if (posted) {           // Let the helper parse it meanwhile
+            pa.input = next;    // Its text
+            pa.arena = &arenas[!cur];  // The other arena
+            sem_post(&pa.job_ready);  // Go
+        }
+        if (error) {            // Bad syntax
+            fprintf(stderr, "w25shell: %s\n", error);  // Report it
+            status = 2;         // Like other shells
+        } else if (tree) {      // Something to run
+            status = execute_node(tree);  // Run it
+        }
+        arena_reset(&arenas[cur]);  // Release the finished line
+        if (!prefetched) fflush(stdout), next = reader_next(r);  // Show this line's output, then wait for the next one
+        line = next;            // Move on
+        if (!line) break;       // End of input
+        cur = !cur;             // Next line lives in the other arena
+        if (posted) {           // Collect the helper's work
+            sem_wait(&pa.job_done);  // Wait for it
+            tree = pa.tree;     // Parsed line
+            error = pa.error;   // Or its error
+        } else {                // Parse inline
+            tree = parse_line(&arenas[cur], line, &error);  // Parse it here
+        }
+    }
+    fflush(stdout);             // Push out anything the shell itself printed
+
+    if (use_parse_ahead) {      // Stop the helper thread
+        pa.input = NULL;        // Exit request
+        sem_post(&pa.job_ready);  // Wake it
+        pthread_join(pa.thread, NULL);  // Wait for it
+    }
+    return status;              // Last command's status
+}
+
+// Completion
+// Tab completes command names (builtins and every $PATH directory) and file
+// paths. Each directory is listed once with large getdents64 reads, sorted,
+// and kept with an inotify watch; any change to the directory drops its
+// listing, so repeated completions in a 500k-entry directory are two binary
+// searches instead of a rescan.
+#define DIR_CACHE_MAX 32        // Directories kept listed at once
+#define DIR_SCAN_BUF (1 << 20)  // getdents64 batch size
+
+typedef struct {                // Cached, sorted listing of one directory
+    char *path;                 // Absolute directory path (NULL = free slot)
+    int wd;                     // inotify watch (-1 = none, listing is never reused)
+    int valid;                  // Listing matches the directory
+    char *pool;                 // Names, NUL-separated
+    size_t pool_len;            // Bytes used in pool
+    size_t pool_cap;            // Room in pool
+    dir_name *names;            // Sorted by name
+    int count;                  // Names listed
+    int cap;                    // Room in names
+    long long used;             // Last use, for eviction
+} dir_cache;
+
+dir_cache dir_caches[DIR_CACHE_MAX];  // Cached directories
+int inotify_fd = -1;            // Watches on them
+arena completion_arena = {0};   // Candidates for one Tab press
+
+void dir_cache_poll(void) {     // Drops listings whose directories changed
+    if (inotify_fd < 0) return; // Nothing watched yet
+    char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));  // Batch of events
+    ssize_t n;                  // Bytes read
+    while ((n = read(inotify_fd, buf, sizeof(buf))) > 0) {  // Non-blocking: only what is queued
+        for (char *p = buf; p < buf + n; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {  // Each event
+            struct inotify_event *ev = (struct inotify_event *)p;  // The event
+            for (int i = 0; i < DIR_CACHE_MAX; i++) {  // Find its directory
+                dir_cache *d = &dir_caches[i];  // Candidate
+                if (!d->path || (d->wd != ev->wd && !(ev->mask & IN_Q_OVERFLOW))) continue;  // Not this one (overflow drops them all)
+                d->valid = 0;   // Rescan on next use
+                if (ev->mask & IN_IGNORED) d->wd = -1;  // Watch is gone (directory removed)
+            }
+        }
+    }
+}
+
+int dir_cache_scan(dir_cache *d) {  // Lists d->path into the cache, 0 or -1
+    int fd = open(d->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);  // The directory
+    if (fd < 0) return -1;      // Gone or not readable
+    if (inotify_fd < 0) inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);  // First watch
+    if (d->wd < 0 && inotify_fd >= 0)  // Watch before listing, so changes during the scan are not missed
+        d->wd = inotify_add_watch(inotify_fd, d->path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    char *buf = malloc(DIR_SCAN_BUF);  // One big batch per getdents64
+    d->pool_len = 0, d->count = 0;  // Start over
+    long n;                     // Bytes returned
+    while ((n = syscall(SYS_getdents64, fd, buf, DIR_SCAN_BUF)) > 0) {  // Thousands of entries per call
+        for (long off = 0; off < n; ) {  // Each record
+            struct dirent64 *e = (struct dirent64 *)(buf + off);  // Same layout as linux_dirent64
+            off += e->d_reclen; // Next record
+            if (e->d_name[0] == '.' && (!e->d_name[1] || (e->d_name[1] == '.' && !e->d_name[2]))) continue;  // Skip . and ..
+            size_t len = strlen(e->d_name) + 1;  // With its NUL
+            if (d->pool_len + len > d->pool_cap) {  // Out of room
+                d->pool_cap = (d->pool_len + len) * 2;  // Grow
+                d->pool = realloc(d->pool, d->pool_cap);  // Resize
+            }
+            if (d->count == d->cap) {  // Out of room
+                d->cap = d->cap ? d->cap * 2 : 256;  // Grow
+                d->names = realloc(d->names, d->cap * sizeof(dir_name));  // Resize
+            }
+            memcpy(d->pool + d->pool_len, e->d_name, len);  // Keep the name
+            d->names[d->count++] = (dir_name){d->pool_len, e->d_type};  // And where it is
+            d->pool_len += len; // Advance
+        }
+    }
+    free(buf);                  // Done with the batch buffer
+    close(fd);                  // And the directory
+    dir_names_sort(d->names, d->count, d->pool, 0);  // Sorted for prefix search
+    d->valid = d->wd >= 0;      // Unwatched listings are used once
+    return 0;                   // Listed
+}
+
+dir_cache *dir_cache_get(const char *path) {  // Sorted listing of a directory, NULL if it cannot be read
+    dir_cache_poll();           // Apply pending changes first
+    dir_cache *d = NULL, *oldest = &dir_caches[0];  // Hit, and the eviction candidate
+    for (int i = 0; i < DIR_CACHE_MAX && !d; i++) {  // Look it up
+        if (dir_caches[i].path && strcmp(dir_caches[i].path, path) == 0) d = &dir_caches[i];  // Hit
+        else if (!dir_caches[i].path || (oldest->path && dir_caches[i].used < oldest->used)) oldest = &dir_caches[i];  // Free or older slot
+    }
+    if (!d) {                   // Miss: take a free or the least recently used slot
+        d = oldest;             // Reuse it
+        if (d->path && d->wd >= 0) inotify_rm_watch(inotify_fd, d->wd);  // Stop watching the old directory
+        free(d->path);          // Forget it
+        d->path = strdup(path), d->wd = -1, d->valid = 0;  // New directory, not listed yet
+    }
+    d->used = now_ns();         // Recently used
+    if (!d->valid && dir_cache_scan(d) < 0) return NULL;  // List it
+    return d;                   // Ready
+}
+
+int dir_cache_lower(dir_cache *d, const char *prefix, size_t len, int upper) {  // First name >= prefix (upper: first name past every name with that prefix)
+    int lo = 0, hi = d->count;  // Search range
+    while (lo < hi) {           // Binary search
+        int mid = lo + (hi - lo) / 2;  // Middle
+        int c = strncmp(d->pool + d->names[mid].off, prefix, len);  // Compare only the prefix
+        if (c < 0 || (upper && c == 0)) lo = mid + 1;  // Before the range
+        else hi = mid;          // In or after it
+    }
+    return lo;                  // Boundary
+}
+
+int dir_is_dir(const char *dir, dir_cache *d, dir_name *n) {  // Whether a listed name is a directory (following symlinks)
+    if (n->type == DT_DIR) return 1;  // Known from getdents64
+    if (n->type != DT_LNK && n->type != DT_UNKNOWN) return 0;  // Known not to be
+    char path[PATH_MAX];        // Full path
+    snprintf(path, sizeof(path), "%s/%s", dir, d->pool + n->off);  // Build it
+    struct stat st;             // Target info
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);  // Only these few need a stat
+}
+
+int completion_cmp(const void *a, const void *b) { return strcmp(*(char **)a, *(char **)b); }  // Sorts candidates
+
+int complete_word(const char *word, int command, ptr_list *out) {  // Candidates for word (completed words, dirs end in /), sorted and unique
+    arena *a = &completion_arena;  // Candidates live here until the next Tab
+    if (command && !strchr(word, '/')) {  // Command name: builtins and $PATH
+        size_t len = strlen(word);  // Prefix length
+        for (int i = 0; i < BUILTIN_SLOTS; i++)  // Builtins first
+            if (builtin_table[i].name && strncmp(builtin_table[i].name, word, len) == 0) list_push(a, out, (char *)builtin_table[i].name);  // Matches
+        char *path_env = getenv("PATH") ? strdup(getenv("PATH")) : NULL;  // Copy to split
+        for (char *save, *dir = path_env ? strtok_r(path_env, ":", &save) : NULL; dir; dir = strtok_r(NULL, ":", &save)) {  // Each PATH directory
+            dir_cache *d = dir_cache_get(dir);  // Its listing
+            if (!d) continue;   // Missing directory
+            for (int i = dir_cache_lower(d, word, len, 0), end = dir_cache_lower(d, word, len, 1); i < end; i++)  // Names with the prefix
+                list_push(a, out, d->pool + d->names[i].off);  // Candidate (executability is left to the shell)
+        }
+        free(path_env);         // Done splitting
+        if (out->count > 1) {   // Several directories can hold the same command
+            qsort(out->items, out->count, sizeof(char *), completion_cmp);  // Sort them
+            int kept = 1;       // Unique so far
+            for (int i = 1; i < out->count; i++)  // Drop repeats
+                if (strcmp(out->items[i], out->items[kept - 1]) != 0) out->items[kept++] = out->items[i];  // Keep new names
+            out->count = kept;  // Unique count
+        }
+    } else {                    // File path
+        const char *slash = strrchr(word, '/');  // Directory part ends here
+        const char *base = slash ? slash + 1 : word;  // Name prefix
+        size_t dir_len = slash ? slash - word + 1 : 0;  // Directory part with its slash
+        char dir[PATH_MAX];     // Absolute directory to list
+        if (word[0] == '~' && word[1] == '/' && getenv("HOME")) snprintf(dir, sizeof(dir), "%s%.*s", getenv("HOME"), (int)dir_len - 1, word + 1);  // ~/...
+        else if (word[0] == '/') snprintf(dir, sizeof(dir), "%.*s", (int)(dir_len ? dir_len : 1), word);  // Absolute
+        else {                  // Relative to the current directory
+            if (!getcwd(dir, sizeof(dir))) return 0;  // Removed from under us
+            size_t cwd_len = strlen(dir);  // Where the relative part goes
+            if (cwd_len + dir_len + 2 > sizeof(dir)) return 0;  // Too long to be a real path
+            dir[cwd_len] = '/';  // Join them
+            memcpy(dir + cwd_len + 1, word, dir_len);  // Directory part as typed
+            dir[cwd_len + 1 + dir_len] = '\0';  // Terminate it
+        }
+        dir_cache *d = dir_cache_get(dir);  // Its listing
+        if (!d) return 0;       // Not a readable directory
+        size_t len = strlen(base);  // Prefix length
+        for (int i = dir_cache_lower(d, base, len, 0), end = dir_cache_lower(d, base, len, 1); i < end; i++) {  // Names with the prefix
+            const char *name = d->pool + d->names[i].off;  // The name
+            if (name[0] == '.' && base[0] != '.') continue;  // Hidden unless asked for
+            int is_dir = dir_is_dir(dir, d, &d->names[i]);  // Gets a trailing /
+            size_t n = strlen(name);  // Name length
+            char *full = arena_alloc(a, dir_len + n + 2);  // Word as typed plus the name
+            memcpy(full, word, dir_len);  // Directory part as typed
+            memcpy(full + dir_len, name, n);  // The name
+            full[dir_len + n] = '/', full[dir_len + n + is_dir] = '\0';  // Directories end in /
+            list_push(a, out, full);  // Candidate (already in order: one sorted directory)
+        }
+    }
+    return out->count;          // Number of candidates
+}
+
+// Line Editing
+// Terminals get a small raw-mode line editor: cursor movement, kill keys, Tab
+// completion, Up and Down through history, and Ctrl-R reverse incremental search. The
+// terminal goes back to its normal mode before each command runs.
+typedef struct {                // State of the line being edited
+    char *buf;                  // The line
+    size_t len;                 // Bytes in it
+    size_t cap;                 // Room in buf
+    size_t pos;                 // Cursor position
+    const char *prompt;         // Prompt in front of it
+} line_editor;
+
+line_editor editor;             // Reused for every prompt
+struct termios editor_saved;    // Terminal mode to restore
+int editor_ok = 0;              // Terminal supports raw mode
+
+void editor_set(const char *text, size_t len) {  // Replaces the line and puts the cursor at its end
+    if (len + 1 > editor.cap) { // Out of room
+        editor.cap = len + 256; // Grow
+        editor.buf = realloc(editor.buf, editor.cap);  // Resize
+    }
+    memcpy(editor.buf, text, len);  // Copy it in
+    editor.len = editor.pos = len;  // Cursor at the end
+}
+
+void editor_insert(const char *text, size_t n) {  // Inserts text at the cursor
+    if (editor.len + n + 1 > editor.cap) {  // Out of room
+        editor.cap = (editor.len + n + 1) * 2;  // Grow
+        editor.buf = realloc(editor.buf, editor.cap);  // Resize
+    }
+    memmove(editor.buf + editor.pos + n, editor.buf + editor.pos, editor.len - editor.pos);  // Open a gap
+    memcpy(editor.buf + editor.pos, text, n);  // Fill it
+    editor.len += n, editor.pos += n;  // Cursor after the text
+}
+
+void editor_delete(size_t from, size_t to) {  // Removes bytes [from, to) and leaves the cursor at from
+    memmove(editor.buf + from, editor.buf + to, editor.len - to);  // Close the gap
+    editor.len -= to - from;    // Shorter
+    editor.pos = from;          // Cursor where the text was
+}
+
+void editor_refresh(void) {     // Redraws the prompt and line in one write
+    char *out;                  // Escape sequence and text
+    size_t size;                // Its length
+    FILE *fp = open_memstream(&out, &size);  // Build it first so the terminal never shows a half-drawn line
+    fprintf(fp, "\r%s%.*s\033[K\r", editor.prompt, (int)editor.len, editor.buf);  // Prompt, line, clear the rest
+    size_t column = strlen(editor.prompt) + editor.pos;  // Where the cursor goes
+    if (column) fprintf(fp, "\033[%zuC", column);  // Move it there
+    fclose(fp);                 // Finish it
+    if (write(STDOUT_FILENO, out, size) < 0) {}  // Nothing to do if the terminal is gone
+    free(out);                  // Release it
+}
+
+void editor_replace_word(size_t start, const char *text, int finish) {  // Replaces the line from start to the cursor with text, quoting what the lexer would split on
+    editor_delete(start, editor.pos);  // Drop the word as typed
+    for (const char *p = text; *p; p++) {  // Insert the completion
+        if (strchr(" \t\\'\"$&;|<>()!`", *p)) editor_insert("\\", 1);  // Quote special characters
+        editor_insert(p, 1);    // The character itself
+    }
+    if (finish && text[strlen(text) - 1] != '/') editor_insert(" ", 1);  // A finished word (directories stay open)
+}
+
+void editor_list(ptr_list *matches) {  // Prints candidates in columns below the line
+    struct winsize ws;          // Terminal size
+    int width = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col ? ws.ws_col : 80;  // Columns available
+    char *out;                  // Everything to print
+    size_t size;                // Its length
+    FILE *fp = open_memstream(&out, &size);  // One write for the whole list
+    fputs("\r\n", fp);          // Below the line
+    if (matches->count > 200) fprintf(fp, "%d possibilities; type more to narrow them\r\n", matches->count);  // Too many to show
+    else {                      // Lay them out
+        int col = 0;            // Widest candidate
+        for (int i = 0; i < matches->count; i++) if ((int)strlen(matches->items[i]) > col) col = strlen(matches->items[i]);  // Measure
+        col += 2;               // Gap between columns
+        int per_row = width / col > 0 ? width / col : 1;  // Columns per row
+        for (int i = 0; i < matches->count; i++)  // Row by row
+            fprintf(fp, "%-*s%s", col, (char *)matches->items[i], (i + 1) % per_row == 0 || i + 1 == matches->count ? "\r\n" : "");  // One cell
+    }
+    fclose(fp);                 // Finish it
+    if (write(STDOUT_FILENO, out, size) < 0) {}  // Show it; the prompt is redrawn after
+    free(out);                  // Release it
+}
+
+void editor_complete(int again) {  // Tab: completes the word before the cursor, lists candidates on a second Tab
+    size_t start = editor.pos;  // Start of the word
+    while (start && (!strchr(" \t;|&<>()", editor.buf[start - 1]) || (start > 1 && editor.buf[start - 2] == '\\'))) start--;  // Back to a separator
+    char word[PATH_MAX];        // Word with quoting removed
+    size_t len = 0;             // Its length
+    for (size_t i = start; i < editor.pos && len + 1 < sizeof(word); i++)  // Unquote it
+        if (!strchr("\\'\"", editor.buf[i]) || (i > start && editor.buf[i - 1] == '\\')) word[len++] = editor.buf[i];  // Keep the character
+    word[len] = '\0';           // Terminate it
+    size_t before = start;      // What precedes the word
+    while (before && (editor.buf[before - 1] == ' ' || editor.buf[before - 1] == '\t')) before--;  // Skip blanks
+    int command = !before || strchr(";|&(", editor.buf[before - 1]);  // First word of a command
+    ptr_list matches = {0};     // Candidates
+    complete_word(word, command, &matches);  // Find them
+    if (matches.count == 1) editor_replace_word(start, matches.items[0], 1);  // Only one: finish the word
+    else if (matches.count > 1) {  // Several: extend to what they share
+        size_t common = strlen(matches.items[0]);  // Shared prefix length
+        for (int i = 1; i < matches.count; i++)  // Against each candidate
+            for (size_t k = 0; k < common; k++) if (((char *)matches.items[i])[k] != ((char *)matches.items[0])[k]) { common = k; break; }  // Shorten it
+        if (common > len) {     // Something to add
+            char *shared = strndup(matches.items[0], common);  // The shared part
+            editor_replace_word(start, shared, 0);  // Extend the word
+            free(shared);       // Done with it
+        } else if (again) editor_list(&matches);  // Second Tab: show them
+        else if (write(STDOUT_FILENO, "\a", 1) < 0) {}  // First Tab: just beep
+    } else if (write(STDOUT_FILENO, "\a", 1) < 0) {}  // Nothing matches
+    arena_reset(&completion_arena);  // Candidates are no longer needed
+}
+
+int editor_read_key(void) {     // Next byte from the terminal, -1 at end of input
+    while (1) {                 // Until a byte arrives
+        event_loop(NULL, STDIN_FILENO);  // Reap background jobs while idle
+        unsigned char c;        // The byte
+        ssize_t n = read(STDIN_FILENO, &c, 1);  // Raw mode: one key at a time
+        if (n == 1) return c;   // Got one
+        if (n == 0 || errno != EINTR) return -1;  // End of input
+    }
+}
+
+int editor_search(void) {       // Ctrl-R: reverse incremental search; returns the key that ended it (0 = cancelled)
+    char query[256];            // What has been typed
+    size_t qlen = 0;            // Its length
+    int match = -1;             // Entry shown (-1 = none yet)
+    char *saved = strndup(editor.buf, editor.len);  // Line to restore on Ctrl-G
+    size_t saved_len = editor.len;  // Its length
+    const char *prompt = editor.prompt;  // Normal prompt
+    char search_prompt[300];    // (reverse-i-search)`query':
+    int key = 18;               // Ctrl-R starts the first search
+    while (1) {                 // One key at a time
+        if (key == 18 || key == 127 || key == 8 || (key >= 32 && key < 127)) {  // Keys that change the search
+            int from = INT_MAX; // Search from the newest entry
+            if (key == 18 && match >= 0) from = match;  // Ctrl-R again: older than the current match
+            else if (key == 127 || key == 8) { if (qlen) qlen--; }  // Shorter query, search again from the top
+            else if (key != 18 && qlen < sizeof(query)) { query[qlen++] = key; if (match >= 0) from = match + 1; }  // Longer query: the current match may still do
+            int found = qlen ? history_search(query, qlen, 0, from) : -1;  // Look it up
+            size_t cur_len;     // Current match text length
+            char *cur = match >= 0 ? history_entry(match, &cur_len) : NULL;  // Current match text
+            while (key == 18 && found >= 0 && cur) {  // Skip entries identical to the one shown
+                size_t len;     // Candidate length
+                char *text = history_entry(found, &len);  // Candidate text
+                if (len != cur_len || memcmp(text, cur, len)) break;  // Different: use it
+                found = history_search(query, qlen, 0, found);  // Same again: keep going
+            }
+            if (found >= 0) {   // Show it
+                size_t len;     // Entry length
+                char *text = history_entry(found, &len);  // Entry text
+                editor_set(text, len);  // Put it in the line
+                editor.pos = (char *)memmem(text, len, query, qlen) - text;  // Cursor on the match
+                match = found;  // Remember it
+            }
+            snprintf(search_prompt, sizeof(search_prompt), "(%sreverse-i-search)`%.*s': ", found < 0 && qlen ? "failed " : "", (int)qlen, query);  // Show the state
+            editor.prompt = search_prompt;  // Draw it in place of the prompt
+            editor_refresh();   // Update the screen
+        } else {                // Anything else ends the search
+            editor.prompt = prompt;  // Normal prompt again
+            if (key == 7 || key == 3) editor_set(saved, saved_len);  // Ctrl-G / Ctrl-C: back to the original line
+            free(saved);        // Done with it
+            editor_refresh();   // Update the screen
+            return key == 7 || key == 3 ? 0 : key;  // Let the editor handle the key
+        }
+        key = editor_read_key();  // Next key
+        if (key < 0) key = 7;   // End of input: cancel
+    }
+}
+
+char *editor_read_line(const char *prompt) {  // Reads one line with editing, NULL at end of input
+    editor.prompt = prompt;     // Shown in front of the line
+    editor.len = editor.pos = 0;  // Empty line
+    if (!editor.buf) editor.cap = 256, editor.buf = malloc(editor.cap);  // First use
+    int browse = -1;            // History entry shown by Up/Down (-1 = the line being typed)
+    char *draft = NULL;         // Line being typed while browsing
+    size_t draft_len = 0;       // Its length
+    struct termios raw = editor_saved;  // Raw mode: no echo, one byte at a time
+    raw.c_iflag &= ~(ICRNL | IXON);  // Keep Enter as \r, let Ctrl-S/Ctrl-Q through
+    raw.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);  // We echo and handle Ctrl-C ourselves
+    raw.c_cc[VMIN] = 1, raw.c_cc[VTIME] = 0;  // Block for each byte
+    fflush(stdout);             // Anything printed before the prompt
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);  // Switch to raw mode
+    editor_refresh();           // Show the prompt
+    int key = 0, prev, done = 0;  // Current and previous key, finished (1 = line, -1 = end of input)
+    while (!done) {             // One key at a time
+        prev = key;             // Two Tabs in a row list the candidates
+        key = editor_read_key(); // Next key
+        if (key == 18) key = editor_search();  // Ctrl-R: search, then handle whatever key ended it
+        switch (key) {          // By key
+            case -1: done = -1; break;  // End of input
+            case 0: break;      // Search was cancelled
+            case '\r': case '\n': done = 1; break;  // Enter
+            case '\t': editor_complete(prev == '\t'); break;  // Tab: complete
+            case 4:             // Ctrl-D: end of input on an empty line, else delete
+                if (!editor.len) done = -1;  // Leave the shell
+                else if (editor.pos < editor.len) editor_delete(editor.pos, editor.pos + 1);  // Delete under the cursor
+                break;
+            case 3:             // Ctrl-C: drop the line
+                if (write(STDOUT_FILENO, "^C", 2) < 0) {}  // Show it
+                editor.len = editor.pos = 0;  // Empty line
+                done = 1;       // Return it (it does nothing)
+                break;
+            case 127: case 8:   // Backspace
+                if (editor.pos) editor_delete(editor.pos - 1, editor.pos);  // Delete before the cursor
+                break;
+            case 1: editor.pos = 0; break;  // Ctrl-A: start of line
+            case 5: editor.pos = editor.len; break;  // Ctrl-E: end of line
+            case 2: if (editor.pos) editor.pos--; break;  // Ctrl-B: back
+            case 6: if (editor.pos < editor.len) editor.pos++; break;  // Ctrl-F: forward
+            case 11: editor.len = editor.pos; break;  // Ctrl-K: kill to end
+            case 21: editor_delete(0, editor.pos); break;  // Ctrl-U: kill to start
+            case 23: {          // Ctrl-W: kill the previous word
+                size_t from = editor.pos;  // Start of the word
+                while (from && editor.buf[from - 1] == ' ') from--;  // Spaces before the cursor
+                while (from && editor.buf[from - 1] != ' ') from--;  // The word itself
+                editor_delete(from, editor.pos);  // Remove both
+                break;
+            }
+            case 12: if (write(STDOUT_FILENO, "\033[H\033[2J", 7) < 0) {} break;  // Ctrl-L: clear the screen
+            case 16: case 14: case 27: {  // Ctrl-P, Ctrl-N, or an escape sequence (arrows, Home, End, Delete)
+                int code = key == 16 ? 'A' : key == 14 ? 'B' : 0;  // Ctrl-P/N act like Up/Down
+                if (key == 27) {  // ESC [ X or ESC O X
+                    int c1 = editor_read_key(), c2 = c1 == '[' || c1 == 'O' ? editor_read_key() : -1;  // Rest of the sequence
+                    code = c2;  // Final byte
+                    if (c2 >= '0' && c2 <= '9') code = editor_read_key() == '~' ? c2 : 0;  // ESC [ N ~
+                }
+                if (code == 'D' && editor.pos) editor.pos--;  // Left
+                else if (code == 'C' && editor.pos < editor.len) editor.pos++;  // Right
+                else if (code == 'H' || code == '1') editor.pos = 0;  // Home
+                else if (code == 'F' || code == '4') editor.pos = editor.len;  // End
+                else if (code == '3' && editor.pos < editor.len) editor_delete(editor.pos, editor.pos + 1);  // Delete
+                else if (code == 'A' || code == 'B') {  // Up / Down through history
+                    if (browse < 0) {  // Leaving the typed line
+                        history_sync();  // Pick up other shells' commands
+                        if (code == 'B' || !hist.count) break;  // Nothing below it / no history
+                        free(draft), draft = strndup(editor.buf, editor.len), draft_len = editor.len;  // Keep it
+                        browse = hist.count;  // Just past the newest entry
+                    }
+                    browse += code == 'A' ? -1 : 1;  // Older or newer
+                    if (browse < 0) browse = 0;  // Stop at the oldest
+                    if (browse >= hist.count) { editor_set(draft, draft_len); browse = -1; break; }  // Back to the typed line
+                    size_t len;     // Entry length
+                    char *text = history_entry(browse, &len);  // Entry text
+                    editor_set(text, len);  // Show it
+                }
+                break;
+            }
+            default:            // Ordinary character
+                if (key >= 32) { char c = key; editor_insert(&c, 1); }  // Insert it (UTF-8 bytes pass through)
+                break;
+        }
+        if (!done) editor_refresh();  // Show the change
+    }
+    free(draft);                // Done browsing
+    if (write(STDOUT_FILENO, "\r\n", 2) < 0) {}  // Move past the line
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &editor_saved);  // Normal mode for the command
+    if (done < 0) return NULL;  // End of input
+    editor.buf[editor.len] = '\0';  // Terminate it
+    return editor.buf;          // Valid until the next prompt
+}
+
+// Server Mode
+// w25shell --serve SOCKET [-j N] listens on a Unix domain socket with N
+// pre-forked workers, each blocked in accept() on the shared socket so the
+// kernel hands every connection to an idle one. A request is one
+// SOCK_SEQPACKET message: the command text, with the client's stdin, stdout
+// and stderr attached as SCM_RIGHTS. The worker forks a copy of itself for
+// the request, which installs those descriptors as its 0, 1 and 2 and runs
+// each line through parse_and_execute(), so commands read and write the
+// client's files, pipes or terminal directly. Because the copy exits
+// afterwards, cd, export, set -o, the command cache and jobs never leak into
+// later requests: each behaves like a fresh -c run without the exec and
+// startup. The reply is a single int (the exit status). A connection can
+// carry any number of requests. Workers that die are replaced.
+// w25shell --connect SOCKET -c TEXT is the matching client.
+#define SERVE_MAX_WORKERS 256   
+
+volatile sig_atomic_t serve_stop = 0;  // Set by SIGTERM/SIGINT in the supervisor
+
+void serve_on_signal(int sig) { serve_stop = 1; }  // Stop accepting and shut the pool down
+
+int serve_address(const char *path, struct sockaddr_un *addr) {  // Fills in a socket address, -1 if the path is too long
+    memset(addr, 0, sizeof(*addr));  // Clean address
+    addr->sun_family = AF_UNIX;  // Local socket
+    if (strlen(path) >= sizeof(addr->sun_path)) {  // sun_path is ~108 bytes
+        fprintf(stderr, "w25shell: %s: socket path too long\n", path);  // Explain
+        return -1;              // Unusable
+    }
+    strcpy(addr->sun_path, path);  // Fits
+    return 0;                   // Ready
+}
+
+int serve_connect(const char *path) {  // Connects to a server, returns the socket or -1
+    struct sockaddr_un addr;    // Server address
+    if (serve_address(path, &addr) < 0) return -1;  // Bad path
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);  // Message boundaries keep requests apart
+    if (fd < 0) return -1;      // Out of descriptors
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) return fd;  // Connected
+    int saved = errno;          // Keep the reason for the caller
+    close(fd);                  // Not connected
+    errno = saved;              // Restore it
+    return -1;                  // No server
+}
+
+int serve_request(int sock, const char *text, const int fds[3]) {  // Runs text on the server with fds as its stdio, returns the status or -1
+    struct iovec iov = {(void *)text, strlen(text) + 1};  // Text and its NUL (so a request is never empty)
+    union { char buf[CMSG_SPACE(3 * sizeof(int))]; struct cmsghdr align; } ctl;  // Room for three descriptors
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf)};  // One message
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);  // The descriptors
+    c->cmsg_level = SOL_SOCKET, c->cmsg_type = SCM_RIGHTS, c->cmsg_len = CMSG_LEN(3 * sizeof(int));  // Passed, not copied
+    memcpy(CMSG_DATA(c), fds, 3 * sizeof(int));  // stdin, stdout, stderr
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) < 0) return -1;  // Server gone
+    int status;                 // Reply
+    ssize_t n;                  // Bytes received
+    while ((n = recv(sock, &status, sizeof(status), 0)) < 0 && errno == EINTR);  // Wait for it
+    if (n != sizeof(status)) { errno = n == 0 ? ECONNRESET : errno; return -1; }  // Worker exited mid-request
+    return status;              // Exit status of the last line
+}
+
+int serve_client(const char *path, const char *text) {  // --connect: runs text on a server with this process's stdio
+    int sock = serve_connect(path);  // Connect
+    if (sock < 0) {             // No server
+        fprintf(stderr, "w25shell: %s: %s\n", path, strerror(errno));  // Say why
+        return 127;             // Like a command that cannot be run
+    }
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};  // Our own stdio
+    int status = serve_request(sock, text, fds);  // Run it
+    if (status < 0) fprintf(stderr, "w25shell: %s: %s\n", path, strerror(errno)), status = 1;  // No reply
+    close(sock);                // Done
+    return status;              // Its status is ours
+}
+
+int serve_run(char *text, const int fds[3]) {  // Runs one request in a forked copy of the worker, returns its status
+    pid_t pid = fork();         // Fresh copy of the warm worker: nothing the request changes survives it
+    if (pid < 0) return 126;    // Could not start it
+    if (pid == 0) {             // Request process
+        for (int i = 0; i < 3; i++) dup2(fds[i], i);  // Client's stdio becomes ours (and commands')
+        int status = 0;         // Last line's status
+        for (char *line = text, *nl; line; line = nl) {  // Each line
+            nl = strchr(line, '\n');  // End of this line
+            if (nl) *nl++ = '\0';  // Split
+            status = parse_and_execute(line);  // Run it like any other line
+        }
+        fflush(stdout), fflush(stderr);  // Output belongs to this request
+        _exit(status);          // Like the end of a -c run
+    }
+    int wstatus;                // How it ended
+    while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR);  // Wait for it
+    return WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);  // Shell-style status
+}
+
+void serve_connection(int conn) {  // Handles every request on one connection
+    while (1) {                 // Until the client hangs up
+        ssize_t len = recv(conn, NULL, 0, MSG_PEEK | MSG_TRUNC);  // Size of the next request, without taking it
+        if (len < 0 && errno == EINTR) continue;  // Interrupted
+        if (len <= 0) return;   // Client closed (requests always carry a NUL)
+        char *text = malloc(len + 1);  // Request text
+        union { char buf[CMSG_SPACE(3 * sizeof(int))]; struct cmsghdr align; } ctl;  // Its descriptors
+        struct iovec iov = {text, len};  // Whole message
+        struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf)};  // Receive both
+        len = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);  // Take it
+        struct cmsghdr *c = len > 0 ? CMSG_FIRSTHDR(&msg) : NULL;  // Attached descriptors
+        int fds[3] = {-1, -1, -1}, nfds = 0;  // stdin, stdout, stderr
+        if (c && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {  // Descriptors came along
+            nfds = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);  // How many
+            memcpy(fds, CMSG_DATA(c), (nfds > 3 ? 3 : nfds) * sizeof(int));  // Keep the first three
+        }
+        int status = 2;         // Malformed request
+        if (len > 0 && nfds == 3 && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {  // Well-formed
+            text[len] = '\0';   // Terminate (the client's NUL may be missing)
+            status = serve_run(text, fds);  // Run it in its own process
+        }
+        for (int i = 0; i < nfds && i < 3; i++) close(fds[i]);  // Client keeps its own copies
+        free(text);             // Done with the text
+        if (len <= 0) return;   // Connection broke mid-message
+        if (send(conn, &status, sizeof(status), MSG_NOSIGNAL) < 0) return;  // Client went away
+    }
+}
+
+void serve_worker(int listen_fd) {  // Worker: accepts connections forever
+    while (1) {                 // One connection at a time
+        int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);  // Kernel picks an idle worker
+        if (conn < 0 && (errno == EINTR || errno == ECONNABORTED)) continue;  // Try again
+        if (conn < 0) { perror("w25shell: accept"); _exit(1); }  // Socket gone
+        struct ucred peer = {.pid = 0, .uid = (uid_t)-1, .gid = (gid_t)-1};  // Who connected (nobody if unknown)
+        socklen_t peer_len = sizeof(peer);  // Its size
+        if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &peer, &peer_len) < 0 || peer.uid != geteuid()) {  // Only our own user may run commands as us
+            fprintf(stderr, "w25shell: rejected connection from uid %d\n", (int)peer.uid);  // Note it
+            close(conn);        // Drop it unanswered
+            continue;           // Next client
+        }
+        serve_connection(conn);  // Serve it
+        close(conn);            // Next client
+    }
+}
+
+pid_t serve_spawn_worker(int listen_fd) {  // Forks one worker
+    pid_t pid = fork();         // The pool is plain processes
+    if (pid == 0) {             // Worker
+        signal(SIGTERM, SIG_DFL), signal(SIGINT, SIG_DFL);  // Shut down when the supervisor says so
+        serve_worker(listen_fd);  // Never returns
+    }
+    return pid;                 // Supervisor keeps track of it
+}
+
+int serve(const char *path, int workers) {  // --serve: runs the worker pool until SIGTERM or SIGINT
+    struct sockaddr_un addr;    // Where to listen
+    if (serve_address(path, &addr) < 0) return 2;  // Bad path
+    int probe = serve_connect(path);  // Is another server already there?
+    if (probe >= 0) {           // Yes: do not steal its socket
+        close(probe);           // Leave it alone
+        fprintf(stderr, "w25shell: %s: a server is already listening\n", path);  // Explain
+        return 1;               // Refuse
+    }
+    struct stat st;             // Leftover socket from a server that died
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);  // Stale: replace it
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);  // Listening socket (shared by every worker)
+    mode_t old_mask = umask(077);  // Socket file is created 0600: only we may connect
+    int bound = fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;  // Create it
+    umask(old_mask);            // Commands get the usual umask
+    if (!bound || chmod(path, 0600) < 0 || listen(fd, SOMAXCONN) < 0) {  // Set it up
+        fprintf(stderr, "w25shell: %s: %s\n", path, strerror(errno));  // Say why not
+        return 1;               // Cannot serve
+    }
+    if (workers < 1) workers = 1;  // At least one
+    if (workers > SERVE_MAX_WORKERS) workers = SERVE_MAX_WORKERS;  // Keep it sane
+    struct sigaction sa = {.sa_handler = serve_on_signal};  // No SA_RESTART, so waitpid() wakes up
+    sigaction(SIGTERM, &sa, NULL), sigaction(SIGINT, &sa, NULL);  // Shut down cleanly
+    signal(SIGPIPE, SIG_DFL);   // Workers writing to a departed client die like any writer would
+    fflush(stdout), fflush(stderr);  // Nothing buffered gets duplicated into workers
+    pid_t pids[SERVE_MAX_WORKERS];  // The pool
+    for (int i = 0; i < workers; i++) pids[i] = serve_spawn_worker(fd);  // Pre-fork it
+    while (!serve_stop) {       // Supervise
+        int wstatus;            // How a worker ended
+        pid_t pid = waitpid(-1, &wstatus, 0);  // Sleep until one exits or we are told to stop
+        if (pid < 0) { if (errno == ECHILD) break; continue; }  // Signal, or nothing left
+        for (int i = 0; i < workers; i++)  // Which slot
+            if (pids[i] == pid && !serve_stop) {  // Replace it
+                if (WIFSIGNALED(wstatus) && WTERMSIG(wstatus) != SIGPIPE)  // Crash worth mentioning
+                    fprintf(stderr, "w25shell: worker %d killed by signal %d\n", (int)pid, WTERMSIG(wstatus));  // Report it
+                pids[i] = serve_spawn_worker(fd);  // Fresh worker
+            }
+    }
+    for (int i = 0; i < workers; i++) if (pids[i] > 0) kill(pids[i], SIGTERM);  // Stop the pool
+    while (waitpid(-1, NULL, 0) > 0 || errno == EINTR);  // Reap every worker
+    unlink(path);               // Remove the socket
+    close(fd);                  // And stop listening
+    return 0;                   // Clean shutdown
+}
+
+// Main Shell Loop
+int main(int argc, char **argv) {  // Main function where everything starts
+    builtin_table_check();     // Catch a mistyped builtin entry before anything runs
+    const char *spawn_mode = getenv("W25SHELL_SPAWN");  // Optional launcher override
+    if (spawn_mode && strcmp(spawn_mode, "fork") == 0) spawn_use_fork = 1;  // Force the fork()+exec path
+    const char *stats = getenv("W25SHELL_STATS");  // Optional JSON stats stream: a file, or fd:N
+    if (stats && strncmp(stats, "fd:", 3) == 0) {  // Already-open descriptor
+        stats_fd = atoi(stats + 3);  // Use it as is
+        if (fcntl(stats_fd, F_SETFD, FD_CLOEXEC) < 0) stats_fd = -1;  // Not open: stats stay off (and commands never see it)
+    } else if (stats && *stats) {  // File to append to
+        stats_fd = open(stats, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);  // Records from every shell land whole
+        if (stats_fd < 0) perror(stats);  // Stats stay off
+    }
+
+    int use_parse_ahead = 0;   // --parse-ahead
+    const char *command = NULL;  // -c text
+    const char *script = NULL; // Script file
+    const char *serve_path = NULL, *connect_path = NULL;  // --serve / --connect socket
+    int serve_workers = sysconf(_SC_NPROCESSORS_ONLN);  // -j: pool size, one per core by default
+    for (int i = 1; i < argc; i++) {  // Parse options
+        if (strcmp(argv[i], "--parse-ahead") == 0) use_parse_ahead = 1;  // Overlap parsing with execution
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) serve_path = argv[++i];  // Server mode
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) connect_path = argv[++i];  // Client mode
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) serve_workers = atoi(argv[++i]);  // Worker count
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) command = argv[++i];  // Run this text
+        else if (!script && !command) script = argv[i];  // Script path
+    }
+
+    if (serve_path) return serve(serve_path, serve_workers);  // Worker pool on a socket
+    if (connect_path) {        // Run one request on a server
+        if (!command) {        // Nothing to send
+            fprintf(stderr, "usage: w25shell --connect SOCKET -c TEXT\n");  // Explain
+            return 2;          // Usage error
+        }
+        return serve_client(connect_path, command);  // Its status is ours
+    }
+
+    if (command || script || !isatty(STDIN_FILENO)) {  // Batch mode: no prompt, block reads
+        line_reader reader;    // Where lines come from
+        if (command) reader_open_text(&reader, command);  // -c text
+        else if (script) {     // Script file
+            int fd = open(script, O_RDONLY | O_CLOEXEC);  // Open it
+            if (fd < 0) {      // If opening failed
+                fprintf(stderr, "w25shell: %s: %s\n", script, strerror(errno));  // Report the error
+                return 127;    // Like other shells
+            }
+            reader_open_fd(&reader, fd);  // Read it in blocks or map it
+        } else reader_open_fd(&reader, STDIN_FILENO);  // Piped or redirected stdin
+        int status = run_batch(&reader, use_parse_ahead);  // Run every line
+        reader_close(&reader); // Release the input
+        return status;         // Last command's status
+    }
+
+    interactive = 1;           // Terminal: prompts and job notices
+    history_open();            // Only terminals keep history
+    const char *term = getenv("TERM");  // Terminals that cannot take escape sequences get plain input
+    editor_ok = tcgetattr(STDIN_FILENO, &editor_saved) == 0 && !(term && strcmp(term, "dumb") == 0);  // Raw mode is possible
+    line_reader reader;        // Lines of any length from the terminal
+    reader_open_fd(&reader, STDIN_FILENO);  // Read stdin directly
+    reader.wait_events = 1;    // Reap background jobs while idle at the prompt
+    while (1) {                // Infinite loop for shell prompt
+        jobs_notify();         // Report background jobs that finished
+        char *input;           // The command line
+        if (editor_ok) input = editor_read_line("w25shell$ ");  // Edited line
+        else {                 // Plain line
+            printf("w25shell$ ");  // Show the prompt
+            fflush(stdout);    // Make sure prompt appears immediately
+            input = reader_next(&reader);  // Read input
+        }
+        if (!input) break;     // Break on EOF
+        char *line = history_expand(input);  // !! and !prefix
+        if (!line) continue;   // Event not found: nothing runs
+        parse_and_execute(line);  // Process the command
+        if (line != input) free(line);  // Expanded copy
     }
+    reader_close(&reader);     // Release the input buffer
     return 0;                  // Exit with success (though we rarely get here)
 }
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Throughput of a script made mostly of builtins (echo, test, cd, pwd, export,
+# true/false), run in-process, against the same script with every builtin that
+# has a program forced out to /bin (cd and export stay builtins).
+# Usage: bench/bench_builtins.sh [lines]
+#   defaults: 100000 lines
+# Needs a built ./w25shell
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+LINES=${1:-100000}
+WORK=${TMPDIR:-/tmp}/w25builtin.$$
+mkdir -p "$WORK/d"
+trap 'rm -rf "$WORK"' EXIT
+
+now() { date +%s.%N; }
+
+# Same fixed line mix every run; one line in ten runs a real program.
+awk -v n="$LINES" -v d="$WORK/d" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        k = i % 10
+        if (k == 0) print "echo line " i " > /dev/null"
+        else if (k == 1) print "test -d " d " && true"
+        else if (k == 2) print "[ " i " -lt " n " ] || false"
+        else if (k == 3) print "cd " d "; cd - > /dev/null"
+        else if (k == 4) print "export BENCH_I=" i
+        else if (k == 5) print "pwd > /dev/null"
+        else if (k == 6) print "false || echo fallback > /dev/null"
+        else if (k == 7) print "test -z \"\" && echo empty > /dev/null"
+        else if (k == 8) print "true; true; true"
+        else print "uname > /dev/null"
+    }
+}' > "$WORK/builtins.sh"
+sed -e 's/^echo /\/bin\/echo /; s/; cd - > \/dev\/null//; s/^test /\/usr\/bin\/test /; s/^\[ /\/usr\/bin\/[ /; s/^pwd /\/bin\/pwd /; s/true/\/bin\/true/g; s/false/\/bin\/false/g' \
+    "$WORK/builtins.sh" > "$WORK/external.sh"
+
+for kind in builtins external; do
+    t0=$(now); "$SHELL_BIN" "$WORK/$kind.sh"; t1=$(now)
+    awk -v k="$kind" -v n="$LINES" -v a="$t0" -v b="$t1" 'BEGIN {
+        s = b - a; printf "bench=builtins mode=%s lines=%d seconds=%.3f lines_per_sec=%.0f\n", k, n, s, n / s }'
+done
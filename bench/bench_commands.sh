@@ -0,0 +1,35 @@
+#!/bin/sh
+# Commands per second for trivial commands: a script of N lines that each run
+# one do-nothing command, as an in-process builtin (true) and as a program
+# (/bin/true), plus the cost of starting a whole shell with -c.
+# Usage: bench/bench_commands.sh [commands]
+#   defaults: 20000 commands
+# Needs a built ./w25shell
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+COUNT=${1:-20000}
+WORK=${TMPDIR:-/tmp}/w25cmds.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+now() { date +%s.%N; }
+
+report() {  # mode commands t0 t1
+    awk -v m="$1" -v n="$2" -v a="$3" -v b="$4" 'BEGIN {
+        s = b - a; printf "bench=commands mode=%s commands=%d seconds=%.3f commands_per_sec=%.0f\n", m, n, s, n / s }'
+}
+
+awk -v n="$COUNT" 'BEGIN { for (i = 0; i < n; i++) print "true" }' > "$WORK/builtin.sh"
+awk -v n="$COUNT" 'BEGIN { for (i = 0; i < n; i++) print "/bin/true" }' > "$WORK/program.sh"
+for mode in builtin program; do
+    t0=$(now); "$SHELL_BIN" "$WORK/$mode.sh"; t1=$(now)
+    report "$mode" "$COUNT" "$t0" "$t1"
+done
+
+# Whole-shell startup: a tenth as many separate "w25shell -c true" runs
+RUNS=$((COUNT / 10))
+t0=$(now)
+i=0
+while [ $i -lt $RUNS ]; do "$SHELL_BIN" -c true; i=$((i + 1)); done
+t1=$(now)
+report shell_startup "$RUNS" "$t0" "$t1"
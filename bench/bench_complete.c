@@ -0,0 +1,70 @@
+// Completion latency benchmark
+// Fills a scratch directory with N empty files, then times a readdir() listing
+// for reference, the cold getdents64 scan that fills the completion cache,
+// warm completions answered from the cache, and the rescan after a file is
+// created (which the inotify watch must notice).
+// Build: make bench_complete
+// Usage: ./bench_complete [entries] [lookups]
+#define main w25shell_main      // Pull in the shell without its main()
+#include "../Unix_Style_Shell_Implementation.c"
+#undef main
+
+double elapsed_ms(long long since) { return (now_ns() - since) / 1e6; }  // Milliseconds since a now_ns() stamp
+
+int complete_count(const char *word) {  // Completes word as a file path, returns the number of candidates
+    ptr_list matches = {0};     // Candidates
+    int n = complete_word(word, 0, &matches);  // Find them
+    arena_reset(&completion_arena);  // Like the editor does after each Tab
+    return n;                   // How many
+}
+
+int main(int argc, char **argv) {  // Builds the directory and prints one result line per measurement
+    int entries = argc > 1 ? atoi(argv[1]) : 1000000;  // Files in the directory
+    int lookups = argc > 2 ? atoi(argv[2]) : 10000;  // Warm completions to average
+    char dir[] = "/tmp/w25complete.XXXXXX";  // Scratch directory
+    if (!mkdtemp(dir)) { perror("mkdtemp"); return 1; }  // Give up
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY);  // Create files relative to it
+    long long t0 = now_ns();    // Start timing
+    for (int i = 0; i < entries; i++) {  // Fixed names: same directory every run
+        char name[32];          // File name
+        snprintf(name, sizeof(name), "file_%07d.log", i);  // Sorted order is numeric order
+        int fd = openat(dfd, name, O_WRONLY | O_CREAT | O_EXCL, 0644);  // Create it empty
+        if (fd < 0) { perror(name); return 1; }  // Out of inodes?
+        close(fd);              // Nothing to write
+    }
+    fprintf(stderr, "created %d files in %.0f ms\n", entries, elapsed_ms(t0));  // Setup, not a result
+    if (chdir(dir) < 0) { perror(dir); return 1; }  // Complete relative names, like at a prompt
+
+    t0 = now_ns();              // Start timing
+    DIR *d = opendir(".");      // Reference: the usual readdir() loop
+    size_t seen = 0;            // Keep the optimizer honest
+    for (struct dirent *e; (e = readdir(d)); ) seen += e->d_name[0] != '.';  // Count names
+    closedir(d);                // Done
+    printf("bench=complete op=readdir_list entries=%zu ms=%.1f\n", seen, elapsed_ms(t0));
+
+    t0 = now_ns();              // Start timing
+    int n = complete_count("file_00001");  // Cold: getdents64 scan, sort, watch
+    printf("bench=complete op=cold entries=%d ms=%.1f matches=%d\n", entries, elapsed_ms(t0), n);
+
+    const char *words[] = {"file_0000123", "file_09", "file_05000", "nothing"};  // Narrow, wide and empty prefixes
+    for (int w = 0; w < 4; w++) {  // Each prefix
+        t0 = now_ns();          // Start timing
+        for (int i = 0; i < lookups; i++) n = complete_count(words[w]);  // Answered from the cache
+        printf("bench=complete op=warm prefix=%s entries=%d us_per_completion=%.2f matches=%d\n", words[w], entries, elapsed_ms(t0) * 1e3 / lookups, n);
+    }
+
+    close(openat(dfd, "file_new.log", O_WRONLY | O_CREAT, 0644));  // A change inotify reports
+    t0 = now_ns();              // Start timing
+    n = complete_count("file_new");  // Must rescan and see it
+    printf("bench=complete op=after_change entries=%d ms=%.1f matches=%d\n", entries + 1, elapsed_ms(t0), n);
+
+    for (int i = 0; i < entries; i++) {  // Clean up
+        char name[32];          // File name
+        snprintf(name, sizeof(name), "file_%07d.log", i);  // Same names
+        unlinkat(dfd, name, 0); // Remove it
+    }
+    unlinkat(dfd, "file_new.log", 0);  // And the extra one
+    close(dfd);                 // Done with the directory
+    rmdir(dir);                 // Remove it
+    return 0;                   // Done
+}
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Fan-out throughput: one producer feeding three consumers (md5sum, cksum,
+# wc -c) through w25shell's |> against bash's "tee >(a) >(b) | c", with the
+# consumers' results compared so both runs are known to see the same bytes.
+# Usage: bench/bench_fanout.sh [size_mb]
+#   defaults: 512 MB
+# Needs a built ./w25shell, ./gen_data (gcc -O2 -o gen_data bench/gen_data.c) and bash
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+GEN=${GEN:-./gen_data}
+MB=${1:-512}
+WORK=${TMPDIR:-/tmp}/w25fanout.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+now() { date +%s.%N; }
+
+"$GEN" binary "$MB" 11 > "$WORK/data"
+cat "$WORK/data" > /dev/null    # Warm the page cache
+
+report() {  # tool t0 t1 result_file
+    awk -v t="$1" -v mb="$MB" -v a="$2" -v b="$3" 'BEGIN {
+        s = b - a; printf "bench=fanout tool=%s branches=3 size_mb=%d seconds=%.3f mb_per_sec=%.1f", t, mb, s, mb / s }'
+}
+
+t0=$(now)
+"$SHELL_BIN" -c "cat $WORK/data |> md5sum > $WORK/w.md5 |> cksum > $WORK/w.ck |> wc -c > $WORK/w.wc"
+t1=$(now)
+report w25shell "$t0" "$t1"; echo
+
+t0=$(now)
+bash -c "cat $WORK/data | tee >(md5sum > $WORK/b.md5) >(cksum > $WORK/b.ck) | wc -c > $WORK/b.wc; wait"
+t1=$(now)
+sleep 0.2                       # bash does not wait for >() processes; let them finish writing
+match=no
+cmp -s "$WORK/w.md5" "$WORK/b.md5" && cmp -s "$WORK/w.ck" "$WORK/b.ck" && cmp -s "$WORK/w.wc" "$WORK/b.wc" && match=yes
+report bash_tee "$t0" "$t1"; echo " match=$match"
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Speed of the file operations across sizes: "# file" (word count),
+# "a + b" (concatenation to a file) and "a ~ b" (swap), in MB/s of input.
+# Usage: bench/bench_fileops.sh [size_mb ...]
+#   defaults: 1 16 256 1024 (pass 4096 for the 4 GB case; needs ~4x the size free)
+# Needs a built ./w25shell and ./gen_data (gcc -O2 -o gen_data bench/gen_data.c)
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+GEN=${GEN:-./gen_data}
+[ $# -gt 0 ] || set -- 1 16 256 1024
+WORK=${TMPDIR:-/tmp}/w25fileops.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+now() { date +%s.%N; }
+
+report() {  # op size_mb input_mb t0 t1
+    awk -v o="$1" -v mb="$2" -v in_mb="$3" -v a="$4" -v b="$5" 'BEGIN {
+        s = b - a; printf "bench=fileops op=%s size_mb=%d seconds=%.3f mb_per_sec=%.1f\n", o, mb, s, in_mb / s }'
+}
+
+for mb in "$@"; do
+    "$GEN" text "$mb" 1 > "$WORK/a"
+    "$GEN" text "$mb" 2 > "$WORK/b"
+
+    t0=$(now); "$SHELL_BIN" -c "# $WORK/a" > /dev/null; t1=$(now)
+    report wordcount "$mb" "$mb" "$t0" "$t1"
+
+    t0=$(now); "$SHELL_BIN" -c "$WORK/a + $WORK/b > $WORK/ab"; t1=$(now)
+    report concat "$mb" $((mb * 2)) "$t0" "$t1"
+    rm -f "$WORK/ab"
+
+    t0=$(now); "$SHELL_BIN" -c "$WORK/a ~ $WORK/b"; t1=$(now)
+    report swap "$mb" $((mb * 2)) "$t0" "$t1"
+    rm -f "$WORK/a" "$WORK/b"
+done
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Glob expansion: time w25shell expanding "**/*.csv" and "*/*/*.log" over a
+# generated tree against bash with globstar and find, counting the matches so
+# every tool is known to see the same files. One run also uses the expansion
+# as argv for a pipeline stage, so tens of thousands of paths are passed on.
+# Usage: bench/bench_glob.sh [dirs] [files_per_dir]
+#   defaults: 200 dirs x 500 files (100k files, half of them .csv)
+# Needs a built ./w25shell and bash
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+DIRS=${1:-200}
+FILES=${2:-500}
+WORK=${TMPDIR:-/tmp}/w25glob.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+now() { date +%s.%N; }
+
+i=0
+while [ $i -lt "$DIRS" ]; do    # tree/dNNN/sub/ with .csv and .log files at two depths
+    mkdir -p "$WORK/tree/d$i/sub"
+    (cd "$WORK/tree/d$i" && seq -f "a%g.csv" 1 $((FILES / 2)) | xargs touch && seq -f "sub/b%g.log" 1 $((FILES / 2)) | xargs touch)
+    i=$((i + 1))
+done
+cd "$WORK/tree"
+
+run() {  # tool pattern command...
+    tool=$1 pattern=$2; shift 2
+    t0=$(now)
+    count=$("$@")
+    t1=$(now)
+    awk -v t="$tool" -v p="$pattern" -v a="$t0" -v b="$t1" -v c="$count" 'BEGIN {
+        printf "bench=glob tool=%s pattern=%s seconds=%.3f matches=%d\n", t, p, b - a, c }'
+}
+
+case $SHELL_BIN in /*) ;; *) SHELL_BIN=$OLDPWD/$SHELL_BIN ;; esac
+run w25shell '**/*.csv' "$SHELL_BIN" -c 'echo **/*.csv | wc -w'
+run bash '**/*.csv' bash -O globstar -c 'echo **/*.csv | wc -w'
+run find '**/*.csv' sh -c 'find . -name "*.csv" | wc -l'
+run w25shell '*/*/*.log' "$SHELL_BIN" -c 'echo */*/*.log | wc -w'
+run bash '*/*/*.log' bash -c 'echo */*/*.log | wc -w'
@@ -0,0 +1,61 @@
+// History index benchmark
+// Writes a history file of N synthetic command lines, then times opening it,
+// the first (indexing) load, !prefix and Ctrl-R substring lookups that hit
+// recent, old and no entries, and appending a line to the loaded index.
+// Build: make bench_history
+// Usage: ./bench_history [entries] [lookups]
+#define main w25shell_main      // Pull in the shell without its main()
+#include "../Unix_Style_Shell_Implementation.c"
+#undef main
+
+double elapsed_us(long long since) { return (now_ns() - since) / 1e3; }  // Microseconds since a now_ns() stamp
+
+double lookup_us(const char *query, int prefix, int lookups, int *found) {  // Average microseconds per search
+    long long t0 = now_ns();    // Start timing
+    for (int i = 0; i < lookups; i++) *found = history_search(query, strlen(query), prefix, INT_MAX);  // Same search each time
+    return elapsed_us(t0) / lookups;  // Per lookup
+}
+
+int main(int argc, char **argv) {  // Builds the file and prints one result line per measurement
+    int entries = argc > 1 ? atoi(argv[1]) : 1000000;  // History size
+    int lookups = argc > 2 ? atoi(argv[2]) : 1000;  // Searches per measurement
+    char path[] = "/tmp/w25history.XXXXXX";  // Scratch history file
+    int fd = mkstemp(path);     // Create it
+    if (fd < 0) { perror("mkstemp"); return 1; }  // Give up
+    FILE *fp = fdopen(fd, "w"); // Buffered writes
+    const char *cmds[] = {"git log --oneline -n", "make -j", "grep -rn TODO src/", "cat data.csv | sort | uniq -c > out",
+                          "ls -la /var/log/app", "# bigfile.txt", "a.txt + b.txt + c.txt", "ssh build-host-"};  // Typical shapes
+    srand(7);                   // Fixed seed: same file every run
+    for (int i = 0; i < entries; i++) fprintf(fp, "%s%d\n", cmds[rand() % 8], rand() % 100000);  // One entry per line
+    fprintf(fp, "rsync -a needle/ backup/\n");  // Newest entry
+    fclose(fp);                 // Flush it
+
+    setenv("W25SHELL_HISTFILE", path, 1);  // Use the scratch file
+    long long t0 = now_ns();    // Start timing
+    history_open();             // What startup does
+    printf("bench=history op=open entries=%d us=%.1f\n", entries + 1, elapsed_us(t0));
+    t0 = now_ns();              // Start timing
+    history_sync();             // First use: map and index everything
+    printf("bench=history op=first_load entries=%d us=%.1f\n", hist.count, elapsed_us(t0));
+
+    hist.last = strdup("");     // Make sure the next line is not a duplicate
+    history_add("needle in the newest line");  // Newest entry, indexed incrementally
+    int found;                  // Entry each search returns
+    struct { const char *query; int prefix; const char *name; } cases[] = {  // What to look up
+        {"needle", 0, "substring_newest"}, {"rsync", 1, "prefix_recent"}, {"ssh build-host-4", 1, "prefix_common"},
+        {"no such command", 0, "substring_miss"}, {"zz", 1, "prefix_short_miss"},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {  // Each case
+        double us = lookup_us(cases[c].query, cases[c].prefix, lookups, &found);  // Average latency
+        printf("bench=history op=%s entries=%d us_per_lookup=%.2f found=%d\n", cases[c].name, hist.count, us, found);
+    }
+    t0 = now_ns();              // Start timing
+    for (int i = 0; i < lookups; i++) {  // Append and index new lines
+        char line[64];          // Distinct each time
+        snprintf(line, sizeof(line), "echo appended %d", i);  // Build it
+        history_add(line);      // Write and index it
+    }
+    printf("bench=history op=append entries=%d us_per_add=%.2f\n", hist.count, elapsed_us(t0) / lookups);
+    unlink(path);               // Remove the scratch file
+    return 0;                   // Done
+}
@@ -0,0 +1,37 @@
+#!/bin/sh
+# killallterms latency at scale: starts N idle shells (a quarter of them
+# ignoring SIGTERM, so the SIGKILL path runs too) and times one killallterms.
+# WARNING: like the command itself, this kills every w25shell you own.
+# Usage: bench/bench_killall.sh [instances ...]
+#   defaults: 10 100 500
+# Needs a built ./w25shell
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+[ $# -gt 0 ] || set -- 10 100 500
+
+WORK=${TMPDIR:-/tmp}/w25killall.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+mkfifo "$WORK/idle"
+exec 3<> "$WORK/idle"           # Keep a writer open so the shells block in read() forever
+
+now() { date +%s.%N; }
+
+for n in "$@"; do
+    i=0
+    while [ $i -lt "$n" ]; do   # Every shell reads from the FIFO, which never delivers a line
+        if [ $((i % 4)) -eq 3 ]; then
+            (trap '' TERM; exec "$SHELL_BIN" < "$WORK/idle" > /dev/null 2>&1) &
+        else
+            "$SHELL_BIN" < "$WORK/idle" > /dev/null 2>&1 &
+        fi
+        i=$((i + 1))
+    done
+    while [ "$(pgrep -c -x -u "$(id -u)" w25shell || true)" -lt "$n" ]; do sleep 0.05; done
+
+    t0=$(now); "$SHELL_BIN" -c killallterms > /dev/null 2>&1 || true; t1=$(now)
+    wait 2> /dev/null || true   # Collect the killed shells
+    left=$(pgrep -c -x -u "$(id -u)" w25shell || true)
+    awk -v n="$n" -v l="$left" -v a="$t0" -v b="$t1" 'BEGIN {
+        s = b - a; printf "bench=killall instances=%d seconds=%.3f survivors=%d\n", n, s, l }'
+done
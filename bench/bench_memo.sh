@@ -0,0 +1,36 @@
+#!/bin/sh
+# Output memoization: time `sort` over a generated file run plainly, as a
+# first `memo` run (miss, stores the output) and as a repeat `memo` run (hit,
+# replays it), checksumming each output so all runs are known to agree.
+# Usage: bench/bench_memo.sh [size_mb...]
+#   defaults: 16 64
+# Needs a built ./w25shell and ./gen_data (gcc -O2 -o gen_data bench/gen_data.c)
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+GEN=${GEN:-./gen_data}
+SIZES=${*:-16 64}
+WORK=${TMPDIR:-/tmp}/w25memo.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+export W25SHELL_MEMO_DIR="$WORK/store"
+
+now() { date +%s.%N; }
+
+run() {  # mode mb command...
+    mode=$1 mb=$2; shift 2
+    t0=$(now)
+    sum=$("$@" | cksum | cut -d' ' -f1)
+    t1=$(now)
+    awk -v m="$mode" -v mb="$mb" -v a="$t0" -v b="$t1" -v c="$sum" 'BEGIN {
+        printf "bench=memo mode=%s size_mb=%d seconds=%.3f cksum=%s\n", m, mb, b - a, c }'
+}
+
+for mb in $SIZES; do
+    "$GEN" text "$mb" 5 > "$WORK/data"
+    cat "$WORK/data" > /dev/null    # Warm the page cache
+    run plain "$mb" "$SHELL_BIN" -c "sort $WORK/data"
+    run miss "$mb" "$SHELL_BIN" -c "memo sort $WORK/data" < /dev/null
+    run hit "$mb" "$SHELL_BIN" -c "memo sort $WORK/data" < /dev/null
+    touch "$WORK/data"              # New mtime: the next run must miss
+    run changed "$mb" "$SHELL_BIN" -c "memo sort $WORK/data" < /dev/null
+done
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Wall-clock scaling of the parallel builtin: compresses a fixed set of
+# synthetic shards with -j 1 .. -j N and reports speedup over -j 1.
+# Usage: bench/bench_parallel.sh [shards] [shard_mb] [max_jobs]
+#   defaults: 8 shards of 16 MB, max_jobs = online CPUs
+# Needs a built ./w25shell and ./gen_data (gcc -O2 -o gen_data bench/gen_data.c)
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+GEN=${GEN:-./gen_data}
+SHARDS=${1:-8}
+SHARD_MB=${2:-16}
+MAX=${3:-$(getconf _NPROCESSORS_ONLN)}
+WORK=${TMPDIR:-/tmp}/w25par.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+now() { date +%s.%N; }
+
+tasks=""
+i=1
+while [ $i -le "$SHARDS" ]; do
+    "$GEN" text "$SHARD_MB" "$i" > "$WORK/shard$i"
+    tasks="$tasks 'gzip -6 -c $WORK/shard$i > $WORK/shard$i.gz'"
+    i=$((i + 1))
+done
+
+base=""
+j=1
+while [ $j -le "$MAX" ]; do
+    t0=$(now); "$SHELL_BIN" -c "parallel -j $j $tasks"; t1=$(now)
+    secs=$(awk -v a="$t0" -v b="$t1" 'BEGIN { printf "%.3f", b - a }')
+    [ -z "$base" ] && base=$secs
+    awk -v j="$j" -v s="$secs" -v b="$base" -v n="$SHARDS" -v mb="$SHARD_MB" 'BEGIN {
+        printf "bench=parallel jobs=%d shards=%d shard_mb=%d seconds=%.3f speedup=%.2f\n", j, n, mb, s, b / s }'
+    j=$((j + 1))
+done
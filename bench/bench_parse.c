@@ -0,0 +1,50 @@
+// Parse throughput benchmark for parse_line()
+// Parses every line of a corpus over and over, resetting the line arena after
+// each one exactly like parse_and_execute() does, and reports lines/s and MB/s.
+// Build: make bench_parse
+// Usage: ./bench_parse [corpus] [passes]
+#define main w25shell_main      // Pull in the shell without its main()
+#include "../Unix_Style_Shell_Implementation.c"
+#undef main
+
+#include <time.h>               
+
+int main(int argc, char **argv) {  // Runs the corpus and prints one result line
+    const char *corpus = argc > 1 ? argv[1] : "bench/corpus/commands.txt";  // Command lines to parse
+    int passes = argc > 2 ? atoi(argv[2]) : 20000;  // Times through the corpus
+    FILE *fp = fopen(corpus, "r");  // Open the corpus
+    if (!fp) {                  // If opening failed
+        perror(corpus);         // Report the error
+        return 1;               // Give up
+    }
+    char **lines = NULL;        // Corpus lines
+    size_t count = 0, bytes = 0;  // Number of lines and total length
+    char *line = NULL;          // getline buffer
+    size_t cap = 0;             // Its size
+    ssize_t len;                // Length of each line
+    while ((len = getline(&line, &cap, fp)) > 0) {  // Read the corpus
+        line[strcspn(line, "\n")] = 0;  // Drop the newline
+        lines = realloc(lines, (count + 1) * sizeof(char *));  // Grow the list
+        lines[count++] = strdup(line);  // Keep a copy
+        bytes += strlen(line);  // Count parsed bytes
+    }
+    free(line);                 // Release the buffer
+    fclose(fp);                 // Close the corpus
+
+    size_t nodes = 0, errors = 0;  // Keep the optimizer honest
+    struct timespec t0, t1;     // Start and end times
+    clock_gettime(CLOCK_MONOTONIC, &t0);  // Start timing
+    for (int pass = 0; pass < passes; pass++) {  // Repeat the corpus
+        for (size_t i = 0; i < count; i++) {  // Every line
+            const char *error = NULL;  // Syntax error, if any
+            node *tree = parse_line(&line_arena, lines[i], &error);  // Parse it
+            if (error) errors++; else if (tree) nodes += tree->count;  // Use the result
+            arena_reset(&line_arena);  // One reset per line
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);  // Stop timing
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;  // Elapsed seconds
+    printf("bench=parse corpus_lines=%zu passes=%d seconds=%.3f lines_per_s=%.0f mb_per_s=%.1f errors=%zu checksum=%zu\n",
+           count, passes, secs, count * passes / secs, bytes * (double)passes / secs / 1e6, errors / passes, nodes);
+    return 0;                   // Done
+}
@@ -0,0 +1,43 @@
+#!/bin/sh
+# Pipeline throughput in MB/s: pushes a synthetic binary file through 1 to N
+# cat stages joined with | (left to right) and with = (right to left), once
+# per pipe capacity ("default" = kernel 64 KiB, else a "pipe -s" size).
+# Usage: bench/bench_pipeline.sh [size_mb] [max_stages] [pipe_sizes]
+#   defaults: 256 MB, 5 stages, "default max"
+# Needs a built ./w25shell and ./gen_data (gcc -O2 -o gen_data bench/gen_data.c)
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+GEN=${GEN:-./gen_data}
+MB=${1:-256}
+MAX=${2:-5}
+SIZES=${3:-default max}
+WORK=${TMPDIR:-/tmp}/w25pipe.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+now() { date +%s.%N; }
+
+"$GEN" binary "$MB" 7 > "$WORK/data"
+cat "$WORK/data" > /dev/null    # Warm the page cache so every run reads from memory
+
+stages=1
+while [ "$stages" -le "$MAX" ]; do
+    # |: cat data | cat | ... > /dev/null    =: cat > /dev/null = ... = cat = cat data
+    fwd="cat $WORK/data"
+    mid=""
+    i=1
+    while [ $i -lt "$stages" ]; do fwd="$fwd | cat"; [ $i -gt 1 ] && mid="$mid = cat"; i=$((i + 1)); done
+    fwd="$fwd > /dev/null"
+    if [ "$stages" -eq 1 ]; then rev=$fwd; else rev="cat > /dev/null$mid = cat $WORK/data"; fi
+    for size in $SIZES; do
+        prefix=""
+        [ "$size" = default ] || prefix="pipe -s $size "
+        for dir in forward reverse; do
+            if [ $dir = forward ]; then line=$fwd; else line=$rev; fi
+            t0=$(now); "$SHELL_BIN" -c "$prefix$line"; t1=$(now)
+            awk -v d="$dir" -v k="$stages" -v p="$size" -v mb="$MB" -v a="$t0" -v b="$t1" 'BEGIN {
+                s = b - a; printf "bench=pipeline direction=%s stages=%d pipe_size=%s size_mb=%d seconds=%.3f mb_per_sec=%.1f\n", d, k, p, mb, s, mb / s }'
+        done
+    done
+    stages=$((stages + 1))
+done
@@ -0,0 +1,104 @@
+// Server mode load generator
+// Sends the same command line as fast as it can from several client threads,
+// first by starting a fresh ./w25shell -c per request (the one-shot
+// baseline), then through a --serve worker pool over one persistent
+// connection per client, then with a new connection per request. Every
+// request's stdio is /dev/null. Prints requests per second and p50/p99
+// latency for each mode.
+// Build: make bench_serve
+// Usage: ./bench_serve [requests] [clients] [workers] [command]
+#define main w25shell_main      // Pull in the shell without its main()
+#include "../Unix_Style_Shell_Implementation.c"
+#undef main
+
+static const char *shell_bin = "./w25shell";  // Shell under test
+static const char *sock_path;   // Server socket
+static const char *bench_command;  // Line every request runs
+static int null_fds[3];         // /dev/null as stdin, stdout, stderr
+static double *latencies;       // Microseconds per request
+static int per_client;          // Requests each client sends
+
+static double now_usec(void) {  // Monotonic clock in microseconds
+    struct timespec ts;         // Current time
+    clock_gettime(CLOCK_MONOTONIC, &ts);  // Read the clock
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;  // Convert to microseconds
+}
+
+static int oneshot(void) {      // One request as a fresh process, returns its status
+    posix_spawn_file_actions_t fa;  // Its stdio
+    posix_spawn_file_actions_init(&fa);  // Start empty
+    for (int i = 0; i < 3; i++) posix_spawn_file_actions_adddup2(&fa, null_fds[i], i);  // /dev/null
+    char *args[] = {(char *)shell_bin, "-c", (char *)bench_command, NULL};  // w25shell -c command
+    pid_t pid;                  // The shell
+    int status = -1;            // Its exit status
+    if (posix_spawn(&pid, shell_bin, &fa, NULL, args, environ) == 0) waitpid(pid, &status, 0);  // Run it to completion
+    posix_spawn_file_actions_destroy(&fa);  // Done
+    return status;              // Raw wait status
+}
+
+static void *client(void *arg) {  // One client thread: mode 0 one-shot, 1 persistent connection, 2 connection per request
+    long id = (long)arg >> 2;   // Which client
+    int mode = (long)arg & 3;   // How it sends requests
+    int sock = mode == 1 ? serve_connect(sock_path) : -1;  // Kept open for the whole run
+    for (int i = 0; i < per_client; i++) {  // Its share of the requests
+        double start = now_usec();  // Request starts
+        if (mode == 0) oneshot();  // Whole new shell
+        else {                  // Through the server
+            if (mode == 2) sock = serve_connect(sock_path);  // Fresh connection
+            if (serve_request(sock, bench_command, null_fds) < 0) perror("request failed");  // Run it
+            if (mode == 2) close(sock);  // And hang up
+        }
+        latencies[id * per_client + i] = now_usec() - start;  // Record it
+    }
+    if (mode == 1) close(sock); // Done with the connection
+    return NULL;                // Finished
+}
+
+static int cmp_double(const void *a, const void *b) {  // qsort order for latencies
+    double x = *(const double *)a, y = *(const double *)b;  // Values
+    return (x > y) - (x < y);   // Ascending
+}
+
+static void run(const char *mode_name, int mode, int clients, int workers) {  // Runs one mode and prints its line
+    pthread_t threads[clients]; // Client threads
+    double start = now_usec();  // Start of the run
+    for (long i = 0; i < clients; i++) pthread_create(&threads[i], NULL, client, (void *)(i << 2 | mode));  // Start them
+    for (int i = 0; i < clients; i++) pthread_join(threads[i], NULL);  // Wait for them
+    double seconds = (now_usec() - start) / 1e6;  // Wall time
+    int total = clients * per_client;  // Requests sent
+    qsort(latencies, total, sizeof(double), cmp_double);  // For percentiles
+    printf("bench=serve mode=%s workers=%d clients=%d requests=%d req_per_sec=%.0f p50_usec=%.1f p99_usec=%.1f\n", mode_name,
+           mode ? workers : 0, clients, total, total / seconds, latencies[total / 2], latencies[(int)(total * 0.99)]);
+}
+
+int main(int argc, char **argv) {  // Starts a server, loads it, compares with one-shot shells
+    int requests = argc > 1 ? atoi(argv[1]) : 2000;  // Requests per mode
+    int clients = argc > 2 ? atoi(argv[2]) : 4;  // Concurrent clients
+    if (clients < 1) clients = 1;  // At least one
+    int workers = argc > 3 ? atoi(argv[3]) : clients;  // Server pool size (a connection holds its worker)
+    bench_command = argc > 4 ? argv[4] : "echo ok";  // Typical small request
+    per_client = requests / clients > 0 ? requests / clients : 1;  // Even split
+    latencies = malloc(sizeof(double) * clients * per_client);  // One slot per request
+    for (int i = 0; i < 3; i++) null_fds[i] = open("/dev/null", O_RDWR | O_CLOEXEC);  // Request stdio
+
+    char path[64], jobs[16];    // Socket path, -j value
+    snprintf(path, sizeof(path), "/tmp/w25serve.%d.sock", (int)getpid());  // Private socket
+    snprintf(jobs, sizeof(jobs), "%d", workers);  // Pool size
+    sock_path = path;           // For the clients
+    char *args[] = {(char *)shell_bin, "--serve", path, "-j", jobs, NULL};  // The server
+    pid_t server;               // Its PID
+    if (posix_spawn(&server, shell_bin, NULL, NULL, args, environ) != 0) { perror(shell_bin); return 1; }  // Start it
+    int probe = -1;             // Wait until it accepts connections
+    for (int i = 0; i < 500 && (probe = serve_connect(path)) < 0; i++) usleep(10000);  // Up to 5 s
+    if (probe < 0) { fprintf(stderr, "server did not start\n"); kill(server, SIGTERM); return 1; }  // Give up
+    close(probe);               // Ready
+
+    run("oneshot", 0, clients, workers);  // Baseline: a new shell per request
+    run("serve", 1, clients, workers);    // Persistent connections
+    run("serve_connect", 2, clients, workers);  // New connection per request
+
+    kill(server, SIGTERM);      // Shut the pool down
+    waitpid(server, NULL, 0);   // It removes the socket
+    free(latencies);            // Done
+    return 0;                   // Finished
+}
@@ -0,0 +1,48 @@
+// Spawn latency microbenchmark for spawn_command()
+// Compares the posix_spawn path against the fork()+exec fallback while the
+// process holds a large resident set, which is what makes fork() expensive.
+// Build: make bench_spawn
+// Usage: ./bench_spawn [iterations] [resident_mb]
+#define main w25shell_main      // Pull in the shell without its main()
+#include "../Unix_Style_Shell_Implementation.c"
+#undef main
+
+#include <time.h>               
+
+static double now_usec(void) {  // Monotonic clock in microseconds
+    struct timespec ts;         // Current time
+    clock_gettime(CLOCK_MONOTONIC, &ts);  // Read the clock
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;  // Convert to microseconds
+}
+
+static double time_spawns(int iterations) {  // Average microseconds per spawn+wait of /bin/true
+    char *args[] = {"true", NULL};  // Cheapest possible command
+    node cmd = {.type = NODE_COMMAND, .count = 1, .argv = args};  // As the parser would build it
+    double start = now_usec();  // Start of the run
+    for (int i = 0; i < iterations; i++) {  // Launch it over and over
+        pid_t pid = spawn_command(&cmd, -1, -1);  // Launch through the shell's engine
+        if (pid > 0) waitpid(pid, NULL, 0);  // Reap it
+    }
+    return (now_usec() - start) / iterations;  // Average latency
+}
+
+int main(int argc, char **argv) {  // Runs both launch modes and prints one line per mode
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;  // Launches per mode
+    size_t resident_mb = argc > 2 ? strtoul(argv[2], NULL, 10) : 512;  // Memory to keep resident
+    char *ballast = malloc(resident_mb << 20);  // Simulates a shell with a big heap
+    if (!ballast) {             // If we could not get the memory
+        perror("malloc failed");  // Report the error
+        return 1;               // Give up
+    }
+    memset(ballast, 1, resident_mb << 20);  // Touch every page so it is really resident
+
+    spawn_use_fork = 1;         // Before: fork()+exec
+    double fork_usec = time_spawns(iterations);  // Measure it
+    spawn_use_fork = 0;         // After: posix_spawn
+    double spawn_usec = time_spawns(iterations);  // Measure it
+
+    printf("bench=spawn mode=fork resident_mb=%zu iterations=%d usec_per_launch=%.1f\n", resident_mb, iterations, fork_usec);
+    printf("bench=spawn mode=posix_spawn resident_mb=%zu iterations=%d usec_per_launch=%.1f\n", resident_mb, iterations, spawn_usec);
+    free(ballast);              // Release the ballast
+    return 0;                   // Done
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Command substitution: time `$(cat file)` captures of growing size through
+# w25shell (arena buffer, then again with big captures spilled to a memfd)
+# against bash, counting the resulting words so all runs are known to agree.
+# Usage: bench/bench_subst.sh [size_mb...]
+#   defaults: 1 16 64
+# Needs a built ./w25shell, ./gen_data (gcc -O2 -o gen_data bench/gen_data.c) and bash
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+GEN=${GEN:-./gen_data}
+SIZES=${*:-1 16 64}
+WORK=${TMPDIR:-/tmp}/w25subst.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+now() { date +%s.%N; }
+
+run() {  # tool mb command...
+    tool=$1 mb=$2; shift 2
+    t0=$(now)
+    words=$("$@")
+    t1=$(now)
+    awk -v t="$tool" -v mb="$mb" -v a="$t0" -v b="$t1" -v w="$words" 'BEGIN {
+        s = b - a; printf "bench=subst tool=%s size_mb=%d seconds=%.3f mb_per_sec=%.1f words=%d\n", t, mb, s, mb / s, w }'
+}
+
+for mb in $SIZES; do
+    "$GEN" text "$mb" 5 > "$WORK/data"
+    cat "$WORK/data" > /dev/null    # Warm the page cache
+    run w25shell "$mb" "$SHELL_BIN" -c "echo \$(cat $WORK/data) | wc -w"
+    run w25shell_memfd "$mb" "$SHELL_BIN" -c "set -o capturememfd 1m; echo \$(cat $WORK/data) | wc -w"
+    run bash "$mb" bash -c "echo \$(cat $WORK/data) | wc -w"
+done
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Word-count throughput: w25shell's "# file" against wc -w on synthetic text.
+# Usage: bench/bench_wordcount.sh [size_mb ...]   (default: 64 512)
+# Needs a built ./w25shell (gcc -O2 -pthread -o w25shell Unix_Style_Shell_Implementation.c)
+set -e
+SHELL_BIN=${SHELL_BIN:-./w25shell}
+WORK=${TMPDIR:-/tmp}/w25bench.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+# 1 MB of words with a fixed seed, repeated to the requested size
+awk 'BEGIN { srand(42); n = 0
+    while (n < 1048576) {
+        len = 1 + int(rand() * 12); w = ""
+        for (i = 0; i < len; i++) w = w sprintf("%c", 97 + int(rand() * 26))
+        sep = (rand() < 0.1) ? "\n" : " "; printf "%s%s", w, sep; n += len + 1
+    } }' > "$WORK/block"
+
+now() { date +%s.%N; }
+
+for mb in ${@:-64 512}; do
+    : > "$WORK/data"
+    i=0; while [ $i -lt "$mb" ]; do cat "$WORK/block"; i=$((i + 1)); done > "$WORK/data"
+    cat "$WORK/data" > /dev/null    # warm the page cache for both tools
+
+    t0=$(now); ours=$("$SHELL_BIN" -c "# $WORK/data"); t1=$(now)
+    theirs=$(wc -w < "$WORK/data"); t2=$(now)
+
+    awk -v mb="$mb" -v a="$t0" -v b="$t1" -v c="$t2" -v o="$ours" -v t="$theirs" 'BEGIN {
+        printf "bench=wordcount tool=w25shell size_mb=%d seconds=%.3f mb_per_s=%.1f words=%s\n", mb, b - a, mb / (b - a), o
+        printf "bench=wordcount tool=wc size_mb=%d seconds=%.3f mb_per_s=%.1f words=%s match=%s\n", mb, c - b, mb / (c - b), t, (o == t) ? "yes" : "no"
+    }'
+done
@@ -0,0 +1,45 @@
+// Fixed-seed synthetic data generator for the benchmarks
+// Build: gcc -O2 -o gen_data bench/gen_data.c
+// Usage: ./gen_data binary|text size_mb [seed] > file
+#include <stdio.h>              
+#include <stdlib.h>             
+#include <string.h>             
+#include <stdint.h>             
+
+static uint64_t rng_state;      // xorshift64* state
+
+static uint64_t rng_next(void) {  // Next pseudo-random 64-bit value
+    rng_state ^= rng_state >> 12;  // Scramble
+    rng_state ^= rng_state << 25;  // Scramble
+    rng_state ^= rng_state >> 27;  // Scramble
+    return rng_state * 2685821657736338717ULL;  // Output multiplier
+}
+
+int main(int argc, char **argv) {  // Writes size_mb of data to stdout
+    if (argc < 3) {             // Need a kind and a size
+        fprintf(stderr, "usage: %s binary|text size_mb [seed]\n", argv[0]);  // Explain usage
+        return 1;               // Give up
+    }
+    int text = strcmp(argv[1], "text") == 0;  // Words and newlines instead of raw bytes
+    unsigned long long total = strtoull(argv[2], NULL, 10) << 20;  // Bytes to write
+    rng_state = argc > 3 ? strtoull(argv[3], NULL, 10) : 42;  // Fixed default seed
+    if (!rng_state) rng_state = 42;  // xorshift must not start at zero
+
+    static unsigned char buf[1 << 20];  // One megabyte at a time
+    for (unsigned long long done = 0; done < total; done += sizeof(buf)) {  // Until size reached
+        for (size_t i = 0; i < sizeof(buf); i += 8) {  // Fill the buffer
+            uint64_t r = rng_next();  // Eight random bytes
+            if (text) {         // Letters separated by spaces and newlines
+                for (int j = 0; j < 8; j++, r >>= 8) {  // Each byte
+                    unsigned v = r & 0xff;  // Byte value
+                    buf[i + j] = v < 32 ? ' ' : v < 36 ? '\n' : 'a' + v % 26;  // Mostly letters
+                }
+            } else {            // Raw bytes, NULs included
+                memcpy(buf + i, &r, 8);  // Copy them in
+            }
+        }
+        size_t n = total - done < sizeof(buf) ? total - done : sizeof(buf);  // Last block may be short
+        if (fwrite(buf, 1, n, stdout) != n) return 1;  // Stop on write error
+    }
+    return 0;                   // Done
+}
@@ -0,0 +1,392 @@
+#!/bin/sh
+# Behaviour tests: each case runs ./w25shell and compares its output and exit
+# status with what a POSIX shell would give.
+# Usage: tests/run_tests.sh   (or: make check)
+SHELL_BIN=$(cd "$(dirname "${SHELL_BIN:-./w25shell}")" && pwd)/$(basename "${SHELL_BIN:-./w25shell}")
+pass=0 fail=0
+SCRATCH=${TMPDIR:-/tmp}/w25check.$$
+mkdir -p "$SCRATCH" && cd "$SCRATCH" || exit 1
+trap 'rm -rf "$SCRATCH"' EXIT
+
+check() {  # name expected_output expected_status command_text
+    out=$("$SHELL_BIN" -c "$4" 2>&1)
+    status=$?
+    if [ "$out" = "$2" ] && [ "$status" = "$3" ]; then
+        pass=$((pass + 1))
+    else
+        fail=$((fail + 1))
+        printf 'FAIL %s\n  expected [%s] status %s\n  got      [%s] status %s\n' "$1" "$2" "$3" "$out" "$status"
+    fi
+}
+
+# Launching programs: redirections, statuses and both launch paths
+for mode in spawn fork; do
+    export W25SHELL_SPAWN=$mode
+    check "$mode: > >> <" "hi
+there" 0 'echo hi > out.txt; echo there >> out.txt; cat < out.txt'
+    check "$mode: redirect before the command" "2" 0 '< out.txt > count.txt wc -l; cat count.txt'
+    check "$mode: exit status" "" 7 'sh -c "exit 7"'
+    check "$mode: command not found" "exec failed: No such file or directory" 127 'no-such-command-w25'
+    check "$mode: pipeline" "HI" 0 'echo hi | tr a-z A-Z'
+done
+unset W25SHELL_SPAWN
+
+# Command cache: remembered paths, stale entries and PATH changes
+mkdir -p b1 b2
+printf '#!/bin/sh\necho one\n' > b1/w25tool
+printf '#!/bin/sh\necho two\n' > b2/w25tool
+chmod +x b1/w25tool b2/w25tool
+OLDPATH=$PATH
+PATH=$SCRATCH/b1:$SCRATCH/b2:$PATH
+check "hash lists what ran" "one
+hits	command
+   1	$SCRATCH/b1/w25tool" 0 'w25tool; hash'
+check "hash -r empties the cache" "hash: hash table empty" 0 'w25tool > /dev/null; hash -r; hash'
+check "stale cached path is looked up again" "one
+two" 0 'w25tool; mv b1/w25tool b1/gone; w25tool; mv b1/gone b1/w25tool'
+check "export PATH drops cached paths" "one
+two" 0 "w25tool; export PATH=$SCRATCH/b2:$PATH; w25tool"
+PATH=$OLDPATH
+
+# # counts words like wc -w: every whitespace kind, empty files, pipes, big files
+printf ' a\tb\n\nc  d\v e\f f\r g' > ws.txt
+check "# mixed whitespace" "$(wc -w < ws.txt | tr -d ' ')" 0 '# ws.txt'
+: > empty.txt
+check "# empty file" "0" 0 '# empty.txt'
+check "# from a pipe" "3" 0 'echo a b c | # /dev/stdin'
+head -c 600 /dev/zero | tr '\0' x > long.txt
+check "# splits words longer than 255 bytes" "3" 0 '# long.txt'
+yes 'ab cdefg  h	ijk' | head -c 70000001 > huge.txt
+check "# over the parallel threshold" "$(wc -w < huge.txt | tr -d ' ')" 0 '# huge.txt'
+rm -f huge.txt
+
+# + copies files byte for byte to a file, a pipe or an append target
+printf 'a\000b\n' > bin1; printf '\377\000\001' > bin2; printf 'tail' > bin3
+cat bin1 bin2 bin3 > expect.bin
+check "+ into a file" "" 0 'bin1 + bin2 + bin3 > got.bin'
+if cmp -s expect.bin got.bin; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL + into a file: contents differ"; fi
+check "+ into a pipe" "$(cksum < expect.bin)" 0 'bin1 + bin2 + bin3 | cksum'
+check "+ appends" "" 0 'cat bin1 > app.bin; bin2 + bin3 >> app.bin'
+if cmp -s expect.bin app.bin; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL + appends: contents differ"; fi
+
+# Parser: no limits on words, pipes, commands or line length; quoting; operators; errors
+check "2000 arguments" "2000" 0 "echo $(seq 1 2000 | tr '\n' ' ') | wc -w"
+check "60-stage pipeline" "x" 0 "echo x $(i=0; while [ $i -lt 60 ]; do printf '| cat '; i=$((i + 1)); done)"
+check "60 && commands" "ok" 0 "true $(i=0; while [ $i -lt 60 ]; do printf '&& true '; i=$((i + 1)); done) && echo ok"
+check "5000-byte word" "5001" 0 "echo $(head -c 5000 /dev/zero | tr '\0' a) | wc -c"
+check "quoting" 'a  b c "d" e f' 0 "echo 'a  b' \"c \\\"d\\\"\" e\\ f"
+check "&& || ;" "or
+and
+end" 0 'false || echo or; true && echo and; false && echo no; echo end'
+check "a=b is a word" "a=b" 0 'echo a=b'
+check "dangling pipe" "w25shell: syntax error near unexpected token \`newline'" 2 'echo a |'
+check "unterminated quote" "w25shell: syntax error: unterminated '" 2 "echo 'open"
+
+# Background jobs: & returns at once, jobs lists them, wait and fg collect their status
+check "& runs in the background" "started
+[1]  Running	sleep 0.3" 0 'sleep 0.3 & echo started; jobs'
+check "wait returns the job's status" "" 5 'sh -c "exit 5" & wait'
+check "wait %1 leaves other jobs" "[2]  Done	sleep 0.1" 0 'sleep 0.3 & sleep 0.1 & wait %1; jobs'
+check "jobs is empty after wait" "" 0 'sleep 0.1 & wait; jobs'
+check "fg waits for the job" "sleep 0.1
+done" 0 'sleep 0.1 & fg; echo done'
+check "wait on an unknown job" "wait: 99999: no such job" 127 'wait 99999'
+
+# parallel: whole-task output, -k keeps argument order, status counts failures
+check "parallel -k keeps order" "a1
+a2
+b" 0 "parallel -j 2 -k 'sleep 0.2; echo a1; echo a2' 'echo b'"
+check "parallel output is not interleaved" "b
+a1
+a2" 0 "parallel -j 2 'sleep 0.2; echo a1; echo a2' 'echo b'"
+check "parallel counts failures" "x" 2 "parallel 'false' 'echo x' 'sh -c \"exit 3\"'"
+check "parallel -j 1 runs one at a time" "1
+2" 0 "parallel -j 1 'sleep 0.2; echo 1' 'echo 2'"
+
+# killallterms ends every other instance, then itself; a renamed copy only sees its own kind
+cp "$SHELL_BIN" w25kill && mkfifo idle
+./w25kill < idle & k1=$!
+./w25kill < idle & k2=$!
+exec 5> idle
+sleep 0.2
+out=$(./w25kill -c killallterms 2>&1) 2>/dev/null; status=$?  # the shell would report "Killed"
+wait "$k1" "$k2"
+exec 5>&-
+if echo "$out" | grep -qx 'Found 2 w25kill instances, killed 2' && [ "$status" = 137 ] &&
+   ! kill -0 "$k1" 2>/dev/null && ! kill -0 "$k2" 2>/dev/null; then
+    pass=$((pass + 1))
+else
+    fail=$((fail + 1)); echo "FAIL killallterms (status $status, got [$out])"
+fi
+
+# Builtins run in the shell: cd and export persist, and they still work inside pipelines
+check "echo -n" "ab c" 0 'echo -n a; echo b c'
+check "cd and pwd" "/" 0 'cd /; pwd'
+check "cd with no argument goes home" "$HOME" 0 'cd; pwd'
+check "cd -" "/" 0 'cd /; cd /tmp; cd - > /dev/null; pwd'
+check "cd to a missing directory" "cd: /no-such-dir-w25: No such file or directory" 1 'cd /no-such-dir-w25'
+check "export reaches children" "bar" 0 'export FOO=bar; printenv FOO'
+check "true and false" "" 1 'true && false'
+check "builtin inside a pipeline" "HI" 0 'echo hi | tr a-z A-Z'
+check "builtin at the end of a pipeline" "$SCRATCH" 0 'echo x | pwd'
+check "builtin output redirected" "to file" 0 'echo to file > builtin.txt; cat builtin.txt'
+
+# time reports real, user and sys and keeps the status; W25SHELL_STATS gets one JSON line per command
+out=$("$SHELL_BIN" -c 'time sleep 0.1 && sh -c "exit 3"; time sh -c "exit 3"' 2>&1); status=$?
+if [ "$status" = 3 ] && [ "$(echo "$out" | grep -c '^real	0m0\.[0-9][0-9][0-9]s$')" = 2 ] &&
+   echo "$out" | grep -q '^real	0m0\.1[0-9][0-9]s$' && echo "$out" | grep -q '^user	' && echo "$out" | grep -q '^sys	'; then
+    pass=$((pass + 1))
+else
+    fail=$((fail + 1)); echo "FAIL time output (status $status, got [$out])"
+fi
+W25SHELL_STATS="$SCRATCH/stats.json" "$SHELL_BIN" -c 'echo a | cat > /dev/null; false'
+if [ "$(wc -l < stats.json)" = 2 ] &&
+   grep -q '"in_process":false,"status":0,.*"cmd":"echo a",.*"spawn_to":"fork",.*"cmd":"cat > /dev/null",.*"spawn_to":"exec"' stats.json &&
+   grep -q '"in_process":true,"status":1,.*"cmd":"false",.*"spawn_to":"none"' stats.json; then
+    pass=$((pass + 1))
+else
+    fail=$((fail + 1)); echo "FAIL stats records"; cat stats.json
+fi
+
+# Pipe tuning: set -o pipesize, pipe -s, packet pipes and the splice meter
+check "set -o pipesize" "pipesize	1048576" 0 'set -o pipesize 1m; set -o | grep pipesize'
+check "set +o pipesize" "pipesize	default" 0 'set -o pipesize 1m; set +o pipesize; set | grep pipesize'
+check "bad pipesize" "set: pipesize: expected bytes, NNk, NNm or max" 2 'set -o pipesize bogus'
+check "pipe -s moves all the data" "3000000" 0 'pipe -s 1m head -c 3000000 /dev/zero | wc -c'
+check "packet pipes move all the data" "3000000" 0 'set -o pipepacket; head -c 3000000 /dev/zero | cat | wc -c'
+check "pipefail" "" 1 'set -o pipefail; false | true'
+out=$("$SHELL_BIN" -c 'pipe -m head -c 100000 /dev/zero | wc -c' 2>&1 | sed 's/ in .*//')
+if [ "$out" = "100000
+meter: head -> wc: 100000 bytes" ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL pipe -m meter (got [$out])"; fi
+if command -v python3 > /dev/null; then
+    getpipesz='python3 -c "import fcntl; print(fcntl.fcntl(1, 1032))"'  # F_GETPIPE_SZ on stdout
+    check "pipe -s sizes the pipe" "1048576" 0 "pipe -s 1m $getpipesz | cat"
+    check "set -o pipesize sizes later pipes" "262144" 0 "set -o pipesize 256k; $getpipesz | cat"
+    check "set +o pipesize restores the default" "65536" 0 "set -o pipesize 256k; set +o pipesize; $getpipesz | cat"
+fi
+
+# |> gives every branch the whole stream, even when one branch stops reading early
+check "|> into files" "A
+B
+2
+a
+b" 0 'printf "a\nb\n" |> wc -l > fan1 |> cat > fan2 |> tr a-z A-Z; cat fan1 fan2'
+head -c 5000000 /dev/urandom > fan.bin
+check "|> copies every byte past an early exit" "$(cksum < fan.bin)
+$(cksum < fan.bin)" 0 'cat fan.bin |> cksum > fan1 |> head -c 10 > /dev/null |> cksum > fan2; cat fan1 fan2'
+check "|> branches can be pipelines" "x
+y" 0 'echo x |> cat | tr x y > fan1 |> cat; cat fan1'
+check "|> status is the last branch's" "x" 4 'echo x |> true |> sh -c "cat; exit 4"'
+
+# $(...) substitutes output: nested, split unless quoted, trailing newlines dropped, any size
+check '$(...) nested' "a b" 0 'echo $(echo a $(echo b))'
+check '$(...) is split into words' "x yend" 0 'echo $(printf "x  y\n\n")end'
+check '"$(...)" is one word' "x  y" 0 'echo "$(printf "x  y")"'
+check '"$(...)" keeps inner newlines' "1
+2" 0 'echo "$(printf "1\n2\n\n")"'
+check '$(...) in single quotes is literal' '$(no)' 0 "echo '\$(no)'"
+check '$(...) of 3 MB' "3000001" 0 'echo $(head -c 3000000 /dev/zero | tr "\0" a) | wc -c'
+check '$(...) as the command' "hi" 0 '$(echo echo) hi'
+
+# Terminal sessions: run the shell on a pseudo-terminal (needs python3) and type lines at its prompt
+pty_run() {  # typed_lines: types each line once the prompt is back, prints the shell's output without prompt lines
+    python3 - "$SHELL_BIN" "$1" <<'EOF' | tr -d '\r' | grep -v 'w25shell\$ '
+import os, pty, select, sys, time
+pid, fd = pty.fork()
+if pid == 0:
+    os.environ["TERM"] = "xterm"
+    os.execv(sys.argv[1], [sys.argv[1]])
+out = b""
+def read_until_prompt():
+    global out
+    start, deadline = len(out), time.time() + 5
+    while time.time() < deadline:
+        new = out[start:]
+        if b"w25shell$ " in new.rsplit(b"\n", 1)[-1] and (start == 0 or b"\n" in new):
+            return
+        if select.select([fd], [], [], 0.1)[0]:
+            try:
+                chunk = os.read(fd, 65536)
+            except OSError:
+                chunk = b""
+            if not chunk:
+                return
+            out += chunk
+read_until_prompt()
+for line in sys.argv[2].split("\n"):
+    os.write(fd, line.encode() + b"\r")
+    read_until_prompt()
+os.write(fd, b"\x04")
+read_until_prompt()
+os.waitpid(pid, 0)
+sys.stdout.write(out.decode(errors="replace"))
+EOF
+}
+pty_check() {  # name expected_output typed_lines
+    out=$(pty_run "$3")
+    if [ "$out" = "$2" ]; then
+        pass=$((pass + 1))
+    else
+        fail=$((fail + 1))
+        printf 'FAIL %s\n  expected [%s]\n  got      [%s]\n' "$1" "$2" "$out"
+    fi
+}
+if command -v python3 > /dev/null; then
+    # History: !prefix and !! at the prompt, shared with later shells through the file
+    export W25SHELL_HISTFILE="$SCRATCH/history"
+    pty_check "!prefix and !!" "one
+echo one
+one
+echo one
+one" 'echo one
+true
+!e
+!!'
+    pty_check "history is shared through the file" "    3  echo one
+    4  history 2" 'history 2'
+    pty_check "unknown event" "w25shell: !zzz: event not found" '!zzz'
+
+    # Tab completion: commands from builtins and $PATH, files, directories, and files created since the last scan
+    mkdir -p compdir && echo content > compdir/complete_me
+    pty_check "Tab completes a command" "hi" "$(printf 'ech\thi')"
+    pty_check "Tab completes a file and a directory" "content" "$(printf 'cat compd\tcomplete_\t')"
+    pty_check "Tab sees a new file" "content
+fresh" "$(printf 'cat compdir/complete_\t\necho fresh > compdir/fresh_w25\ncat compdir/fresh\t')"
+    unset W25SHELL_HISTFILE
+fi
+
+# Globbing and braces: sorted matches, hidden files only for a leading dot, ** recursion, literal when quoted or unmatched
+mkdir -p glob/sub/deep && touch glob/a.c glob/b.c glob/ab.h glob/.hid.c glob/sub/x.c glob/sub/deep/y.c
+check "* and ?" "glob/a.c glob/ab.h glob/b.c glob/a.c glob/b.c" 0 'echo glob/*.? glob/?.c'
+check "[...] and [!...]" "glob/a.c glob/b.c glob/b.c" 0 'echo glob/[ab].c glob/[!a].c'
+check ".* matches hidden files" "glob/.hid.c" 0 'echo glob/.*.c'
+check "** recurses" "glob/a.c glob/b.c glob/sub/deep/y.c glob/sub/x.c" 0 'echo glob/**/*.c'
+check "trailing / keeps directories" "glob/sub/" 0 'echo glob/*/'
+check "no match stays literal" "glob/*.zzz" 0 'echo glob/*.zzz'
+check "quoted patterns stay literal" "glob/*.c glob/*.c glob/*.c" 0 "echo 'glob/*.c' \"glob/*.c\" glob/\\*.c"
+check "braces" "glob/a.c glob/b.c x1 x2 x3 ad bd cd" 0 'echo glob/{a,b}.c x{1..3} {a,{b,c}}d'
+check "over 256 brace words" "300 400" 0 'echo $(echo x{1..300} | wc -w) $(echo {a,b}{1..200} | wc -w)'
+check "unclosed brace stays literal" "a{b" 0 'echo a{b'
+
+# test and [ take = as the string operator, not the reverse pipe
+check "test a = b" "" 1 'test a = b'
+check "test a = a" "" 0 'test a = a'
+check "[ a = a ]" "" 0 '[ a = a ]'
+check "[ a = b ]" "" 1 '[ a = b ]'
+check "[ a == a ]" "yes" 0 '[ a == a ] && echo yes'
+check "= still pipes" "6" 0 'wc -c = echo hello'
+
+# File operations report failure in their exit status
+printf 'one two\nthree\n' > words.txt
+check "# counts words" "3" 0 '# words.txt'
+check "# missing file fails" "open failed: No such file or directory" 1 '# missing.txt'
+check "~ failure stops &&" "~ failed: No such file or directory" 1 'missing.txt ~ other.txt && echo ok'
+check "+ failure is reported" "one two
+three
+open failed: No such file or directory" 1 'words.txt + missing.txt'
+
+# ~ swaps binary contents (NUL bytes included), on one filesystem and across two
+swap_check() {  # name dir_for_file2
+    printf 'first\000file\001' > swap_a
+    printf 'second\000\000file' > "$2/swap_b.$$"
+    sum_a=$(cksum < swap_a) sum_b=$(cksum < "$2/swap_b.$$")
+    "$SHELL_BIN" -c "swap_a ~ $2/swap_b.$$"
+    status=$?
+    if [ "$status" = 0 ] && [ "$(cksum < swap_a)" = "$sum_b" ] && [ "$(cksum < "$2/swap_b.$$")" = "$sum_a" ]; then
+        pass=$((pass + 1))
+    else
+        fail=$((fail + 1)); echo "FAIL $1 (status $status)"
+    fi
+    rm -f swap_a "$2/swap_b.$$"
+}
+swap_check "~ same filesystem" "$SCRATCH"
+if [ -d /dev/shm ] && [ "$(stat -c %d /dev/shm)" != "$(stat -c %d "$SCRATCH")" ]; then
+    swap_check "~ across filesystems" /dev/shm
+fi
+
+# memo replays only while its inputs are unchanged
+export W25SHELL_MEMO_DIR="$SCRATCH/memo"
+printf 'b\na\n' > unsorted
+check "memo miss" "a
+b" 0 'memo sort < unsorted'
+check "memo hit" "a
+b" 0 'memo sort < unsorted'
+printf 'c\nb\n' > unsorted
+check "memo input changed" "b
+c" 0 'memo sort < unsorted'
+check "memo failure status" "" 1 'memo false < /dev/null'
+out=$(echo first | "$SHELL_BIN" -c 'memo cat'; echo second | "$SHELL_BIN" -c 'memo cat')
+if [ "$out" = "first
+second" ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL memo with piped stdin replayed old output (got [$out])"; fi
+check "memo hit does not run the command" "out
+out
+ran" 0 'memo sh -c "echo ran >> runs.log; echo out" < /dev/null; memo sh -c "echo ran >> runs.log; echo out" < /dev/null; cat runs.log'
+printf 'x y\n' > memo.txt
+check "memo argument file" "x y
+x y" 0 'memo cat memo.txt < /dev/null; memo cat memo.txt > memo.out < /dev/null; cat memo.out'
+echo z >> memo.txt
+check "memo argument file changed" "3" 0 'memo # memo.txt'
+out=$(FOO=1 "$SHELL_BIN" -c 'memo printenv FOO < /dev/null'; FOO=2 "$SHELL_BIN" -c 'memo printenv FOO < /dev/null')
+if [ "$out" = "1
+2" ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL memo environment change replayed old output (got [$out])"; fi
+check "memo rejects pipelines" "w25shell: memo: only single commands can be memoized" 2 'memo sort | cat'
+unset W25SHELL_MEMO_DIR
+
+# Batch mode: script files and redirected stdin run every line; the last status is the exit status
+printf 'echo a\nfalse\necho b\nsh -c "exit 4"\n' > script.w25
+out=$("$SHELL_BIN" script.w25 2>&1); status=$?
+if [ "$out" = "a
+b" ] && [ "$status" = 4 ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL script file (got [$out] status $status)"; fi
+out=$("$SHELL_BIN" < script.w25 2>&1); status=$?
+if [ "$out" = "a
+b" ] && [ "$status" = 4 ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL script on stdin (got [$out] status $status)"; fi
+printf 'echo %s\n' "$(head -c 200000 /dev/zero | tr '\0' a)" > longline.w25
+out=$("$SHELL_BIN" < longline.w25 | wc -c | tr -d ' ')
+if [ "$out" = 200001 ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL 200000-byte script line (got [$out])"; fi
+out=$("$SHELL_BIN" no-such-script.w25 2>&1); status=$?
+if [ "$out" = "w25shell: no-such-script.w25: No such file or directory" ] && [ "$status" = 127 ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL missing script (got [$out] status $status)"; fi
+check "-c runs every line" "1
+2" 0 "echo 1
+echo 2"
+
+# Piped input: each line's output appears before the next line is sent
+WORK=${TMPDIR:-/tmp}/w25test.$$
+mkdir -p "$WORK" && mkfifo "$WORK/in" "$WORK/out"
+"$SHELL_BIN" < "$WORK/in" > "$WORK/out" &
+exec 3> "$WORK/in" 4< "$WORK/out"
+echo 'echo one' >&3
+line=$(timeout 5 head -n 1 <&4)
+exec 3>&- 4<&-
+wait
+rm -rf "$WORK"
+if [ "$line" = "one" ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL piped line runs before the next arrives (got [$line])"; fi
+
+# Server mode: requests on one worker do not see each other's state
+SOCK=${TMPDIR:-/tmp}/w25test.$$.sock
+"$SHELL_BIN" --serve "$SOCK" -j 1 &
+server=$!
+i=0; while [ ! -S "$SOCK" ] && [ $i -lt 100 ]; do sleep 0.05; i=$((i + 1)); done
+serve_check() {  # name expected_output expected_status command_text
+    out=$("$SHELL_BIN" --connect "$SOCK" -c "$4" 2>&1)
+    status=$?
+    if [ "$out" = "$2" ] && [ "$status" = "$3" ]; then
+        pass=$((pass + 1))
+    else
+        fail=$((fail + 1))
+        printf 'FAIL %s\n  expected [%s] status %s\n  got      [%s] status %s\n' "$1" "$2" "$3" "$out" "$status"
+    fi
+}
+if [ "$(stat -c %a "$SOCK")" = 600 ]; then pass=$((pass + 1)); else fail=$((fail + 1)); echo "FAIL server socket is not 0600"; fi
+serve_check "serve export" "1" 0 'export X=1; printenv X'
+serve_check "serve export is gone" "" 1 'printenv X'
+serve_check "serve cd" "/" 0 'cd /; pwd'
+serve_check "serve cd is gone" "$(pwd)" 0 'pwd'
+serve_check "serve set -o" "" 0 'set -o pipefail'
+serve_check "serve set -o is gone" "" 0 'false | true'
+serve_check "serve status" "" 3 'test 1 -eq 1 && false || sh -c "exit 3"'
+serve_check "serve killterm" "" 0 'killterm'
+serve_check "serve after killterm" "ok" 0 'echo ok'
+kill "$server"; wait "$server"
+
+echo "tests: $pass passed, $fail failed"
+[ "$fail" -eq 0 ]